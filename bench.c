@@ -0,0 +1,434 @@
+/*****************************************************************************
+ * colorbars: a vapoursynth plugin for generating color bar test patterns
+ *****************************************************************************
+ * VapourSynth plugin
+ *     Copyright (C) 2022 Phillip Blucas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *****************************************************************************/
+// Benchmark: loads the plugin into a fresh core through the C API and sweeps every system, depth,
+// SDR/HLG/PQ mode, compatability, iq and wcg setting.  One CSV line per accepted combination.
+//
+//     make bench && ./bench [--plugin=path] [--frames=N] [--output=file] [--threads=N] > bench.csv
+//
+// --hash widens the sweep to the other options, formats and patterns and prints per-plane hashes
+// of opt=1, the scalar single threaded reference, instead of timings.  Every case is also rendered
+// with the default path and must match it.  --verify=golden.csv compares the hashes against an
+// earlier --hash run; make check does that with the golden.csv in the tree.
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+#include <VapourSynth4.h>
+#include <VSHelper4.h>
+
+#ifdef _WIN32
+#define DEFAULT_PLUGIN ".libs/libcolorbars.dll"
+#define DEFAULT_OUTPUT "NUL"
+#elif defined(__APPLE__)
+#define DEFAULT_PLUGIN ".libs/libcolorbars.dylib"
+#define DEFAULT_OUTPUT "/dev/null"
+#else
+#define DEFAULT_PLUGIN ".libs/libcolorbars.so"
+#define DEFAULT_OUTPUT "/dev/null"
+#endif
+
+static double now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER t, f;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    return (double)t.QuadPart / f.QuadPart;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+// high water mark of the whole process in KiB
+static long peak_rss(void)
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)) ? (long)(pmc.PeakWorkingSetSize / 1024) : 0;
+#else
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024;
+#else
+    return ru.ru_maxrss;
+#endif
+#endif
+}
+
+typedef struct {
+    int resolution;
+    int format;
+    int hdr;
+    int wcg;
+    int compatability;
+    int iq;
+    // the rest keep their defaults when negative
+    int subblack;
+    int superwhite;
+    int halfline;
+    int filter;
+    int scan;
+    int pattern;
+    int timecode;
+} BenchCase;
+
+// Options layered over every timed case by --hash.  A zero format keeps the 10 or 12-bit one,
+// the others are only run once instead of for both depths.
+typedef struct {
+    int subblack;
+    int superwhite;
+    int halfline;
+    int filter;
+    int scan;
+    int pattern;
+    int timecode;
+    int sdr_format;
+    int hdr_format;
+} BenchVariant;
+
+static const BenchVariant variants[] = { { -1, -1, -1, -1, -1, -1, -1, 0, 0 },
+                                         {  0,  0, -1, -1, -1, -1, -1, 0, 0 },
+                                         { -1, -1,  1, -1, -1, -1, -1, 0, 0 },
+                                         { -1, -1, -1,  0, -1, -1, -1, 0, 0 },
+                                         { -1, -1, -1, -1,  1, -1, -1, 0, 0 },
+                                         { -1, -1, -1, -1,  2, -1, -1, 0, 0 },
+                                         { -1, -1, -1, -1, -1,  1, -1, 0, 0 },
+                                         { -1, -1, -1, -1, -1, -1,  1, 0, 0 },
+                                         { -1, -1, -1, -1, -1, -1, -1, pfYUV422P8, pfRGB24 },
+                                         { -1, -1, -1, -1, -1, -1, -1, pfYUV420P16, pfRGB48 },
+                                         { -1, -1, -1, -1, -1, -1, -1, pfYUV444PS, pfRGBS } };
+
+static void set_args(VSMap *args, const BenchCase *c, int frames, const VSAPI *vsapi)
+{
+    vsapi->mapSetInt(args, "resolution", c->resolution, maReplace);
+    vsapi->mapSetInt(args, "format", c->format, maReplace);
+    vsapi->mapSetInt(args, "hdr", c->hdr, maReplace);
+    vsapi->mapSetInt(args, "wcg", c->wcg, maReplace);
+    vsapi->mapSetInt(args, "compatability", c->compatability, maReplace);
+    vsapi->mapSetInt(args, "iq", c->iq, maReplace);
+    vsapi->mapSetInt(args, "length", frames, maReplace);
+    const char *keys[7] = { "subblack", "superwhite", "halfline", "filter", "scan", "pattern", "timecode" };
+    const int values[7] = { c->subblack, c->superwhite, c->halfline, c->filter, c->scan, c->pattern, c->timecode };
+    for (int i = 0; i < 7; i++)
+        if (values[i] >= 0)
+            vsapi->mapSetInt(args, keys[i], values[i], maReplace);
+}
+
+// Returns 0 when the plugin rejects the combination, 1 after printing a line, -1 on a failure
+static int run_case(VSPlugin *plugin, const BenchCase *c, int frames, const char *output, const VSAPI *vsapi)
+{
+    VSMap *args = vsapi->createMap();
+    set_args(args, c, frames, vsapi);
+
+    // first frame latency covers creating the filter too, which is what a script sees
+    const double t0 = now();
+    VSMap *ret = vsapi->invoke(plugin, "ColorBars", args);
+    if (vsapi->mapGetError(ret))
+    {
+        vsapi->freeMap(ret);
+        vsapi->freeMap(args);
+        return 0;
+    }
+    VSNode *node = vsapi->mapGetNode(ret, "clip", 0, NULL);
+    vsapi->freeMap(ret);
+    char error[1024];
+    const VSFrame *frame = vsapi->getFrame(0, node, error, sizeof(error));
+    const double t1 = now();
+    if (!frame)
+    {
+        fprintf(stderr, "bench: %s\n", error);
+        vsapi->freeNode(node);
+        vsapi->freeMap(args);
+        return -1;
+    }
+    vsapi->freeFrame(frame);
+    const VSVideoInfo vi = *vsapi->getVideoInfo(node);
+    char name[32] = "";
+    vsapi->getVideoFormatName(&vi.format, name);
+
+    for (int n = 1; n < frames; n++)
+    {
+        frame = vsapi->getFrame(n, node, error, sizeof(error));
+        if (!frame)
+        {
+            fprintf(stderr, "bench: %s\n", error);
+            vsapi->freeNode(node);
+            vsapi->freeMap(args);
+            return -1;
+        }
+        vsapi->freeFrame(frame);
+    }
+    const double t2 = now();
+    vsapi->freeNode(node);
+
+    vsapi->mapSetData(args, "file", output, -1, dtUtf8, maReplace);
+    const double t3 = now();
+    ret = vsapi->invoke(plugin, "Write", args);
+    const double t4 = now();
+    int64_t bytes = 0;
+    if (vsapi->mapGetError(ret))
+        fprintf(stderr, "bench: %s\n", vsapi->mapGetError(ret));
+    else
+        bytes = vsapi->mapGetInt(ret, "bytes", 0, NULL);
+    vsapi->freeMap(ret);
+    vsapi->freeMap(args);
+
+    printf("%d,%s,%d,%d,%d,%d,%d,%d,%.3f,%.1f,%.1f,%ld\n", c->resolution, name, c->hdr, c->wcg, c->compatability, c->iq,
+           vi.width, vi.height, (t1 - t0) * 1e3, frames > 1 ? (frames - 1) / (t2 - t1) : 0.0,
+           bytes / (t4 - t3) / (1 << 20), peak_rss());
+    fflush(stdout);
+    return 1;
+}
+
+// FNV-1a over the visible samples of every row, so the stride doesn't matter
+static uint64_t hash_plane(uint64_t h, const VSFrame *frame, int plane, const VSAPI *vsapi)
+{
+    const uint8_t *p = vsapi->getReadPtr(frame, plane);
+    const ptrdiff_t stride = vsapi->getStride(frame, plane);
+    const int rowsize = vsapi->getFrameWidth(frame, plane) * vsapi->getVideoFrameFormat(frame)->bytesPerSample;
+    for (int y = 0; y < vsapi->getFrameHeight(frame, plane); y++, p += stride)
+        for (int x = 0; x < rowsize; x++)
+            h = (h ^ p[x]) * 1099511628211ULL;
+    return h;
+}
+
+// Hashes each plane of the first two frames (both fields, or two zone plate frames) with the given opt
+static int hash_case(VSPlugin *plugin, const BenchCase *c, int opt, uint64_t hashes[3], const VSAPI *vsapi)
+{
+    VSMap *args = vsapi->createMap();
+    set_args(args, c, 2, vsapi);
+    vsapi->mapSetInt(args, "opt", opt, maReplace);
+    VSMap *ret = vsapi->invoke(plugin, "ColorBars", args);
+    vsapi->freeMap(args);
+    if (vsapi->mapGetError(ret))
+    {
+        vsapi->freeMap(ret);
+        return 0;
+    }
+    VSNode *node = vsapi->mapGetNode(ret, "clip", 0, NULL);
+    vsapi->freeMap(ret);
+    for (int p = 0; p < 3; p++)
+        hashes[p] = 1469598103934665603ULL;
+    char error[1024];
+    for (int n = 0; n < 2; n++)
+    {
+        const VSFrame *frame = vsapi->getFrame(n, node, error, sizeof(error));
+        if (!frame)
+        {
+            fprintf(stderr, "bench: %s\n", error);
+            vsapi->freeNode(node);
+            return -1;
+        }
+        for (int p = 0; p < vsapi->getVideoFrameFormat(frame)->numPlanes; p++)
+            hashes[p] = hash_plane(hashes[p], frame, p, vsapi);
+        vsapi->freeFrame(frame);
+    }
+    vsapi->freeNode(node);
+    return 1;
+}
+
+// Prints the case and the hashes of the reference, or checks them against the golden lines, which
+// are cleared as they are matched.  Returns -1 on a mismatch.
+static int run_hash(VSPlugin *plugin, const BenchCase *c, char **golden, int num_golden, const VSAPI *vsapi)
+{
+    uint64_t hashes[3], reference[3];
+    int r = hash_case(plugin, c, 1, reference, vsapi);
+    if (r <= 0)
+        return r;
+    char key[256], line[320];
+    snprintf(key, sizeof(key), "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,", c->resolution, c->format, c->hdr, c->wcg,
+             c->compatability, c->iq, c->subblack, c->superwhite, c->halfline, c->filter, c->scan, c->pattern, c->timecode);
+    snprintf(line, sizeof(line), "%s%016llx,%016llx,%016llx", key, (unsigned long long)reference[0],
+             (unsigned long long)reference[1], (unsigned long long)reference[2]);
+
+    int result = 1;
+    if (hash_case(plugin, c, 0, hashes, vsapi) <= 0 || memcmp(hashes, reference, sizeof(hashes)))
+    {
+        fprintf(stderr, "bench: the default path differs from the scalar reference: %s\n", key);
+        result = -1;
+    }
+    if (!golden)
+    {
+        printf("%s\n", line);
+        fflush(stdout);
+        return result;
+    }
+    for (int i = 0; i < num_golden; i++)
+    {
+        if (!strncmp(golden[i], key, strlen(key)))
+        {
+            if (strcmp(golden[i], line))
+            {
+                fprintf(stderr, "bench: differs from the golden output: %s\n", key);
+                result = -1;
+            }
+            golden[i][0] = 0;
+            return result;
+        }
+    }
+    fprintf(stderr, "bench: not in the golden output: %s\n", key);
+    return -1;
+}
+
+static char **read_lines(const char *path, int *count)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return NULL;
+    char **lines = NULL;
+    char buf[512];
+    *count = 0;
+    while (fgets(buf, sizeof(buf), f))
+    {
+        buf[strcspn(buf, "\r\n")] = 0;
+        lines = (char **)realloc(lines, (*count + 1) * sizeof(char *));
+        lines[*count] = (char *)malloc(strlen(buf) + 1);
+        strcpy(lines[(*count)++], buf);
+    }
+    fclose(f);
+    return lines;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = DEFAULT_PLUGIN;
+    const char *output = DEFAULT_OUTPUT;
+    int frames = 100;
+    int threads = 0;
+    int hash = 0;
+    const char *verify = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strncmp(argv[i], "--plugin=", 9))
+            path = argv[i] + 9;
+        else if (!strncmp(argv[i], "--frames=", 9))
+            frames = atoi(argv[i] + 9);
+        else if (!strncmp(argv[i], "--output=", 9))
+            output = argv[i] + 9;
+        else if (!strncmp(argv[i], "--threads=", 10))
+            threads = atoi(argv[i] + 10);
+        else if (!strcmp(argv[i], "--hash"))
+            hash = 1;
+        else if (!strncmp(argv[i], "--verify=", 9))
+            verify = argv[i] + 9;
+        else
+        {
+            fprintf(stderr, "usage: %s [--plugin=%s] [--frames=100] [--output=%s] [--threads=N] [--hash | --verify=golden.csv]\n",
+                    argv[0], DEFAULT_PLUGIN, DEFAULT_OUTPUT);
+            return 1;
+        }
+    }
+    if (frames < 1)
+        frames = 1;
+
+    const VSAPI *vsapi = getVapourSynthAPI(VAPOURSYNTH_API_VERSION);
+    if (!vsapi)
+    {
+        fprintf(stderr, "bench: VapourSynth API %d not available\n", VAPOURSYNTH_API_VERSION);
+        return 1;
+    }
+    // no autoloading, so an installed copy of the plugin can't shadow the one being measured
+    VSCore *core = vsapi->createCore(ccfDisableAutoLoading);
+    if (threads > 0)
+        vsapi->setThreadCount(threads, core);
+
+    VSMap *args = vsapi->createMap();
+    vsapi->mapSetData(args, "path", path, -1, dtUtf8, maReplace);
+    VSMap *ret = vsapi->invoke(vsapi->getPluginByID(VSH_STD_PLUGIN_ID, core), "LoadPlugin", args);
+    vsapi->freeMap(args);
+    if (vsapi->mapGetError(ret))
+    {
+        fprintf(stderr, "bench: %s\n", vsapi->mapGetError(ret));
+        vsapi->freeMap(ret);
+        vsapi->freeCore(core);
+        return 1;
+    }
+    vsapi->freeMap(ret);
+    VSPlugin *plugin = vsapi->getPluginByID("com.ifb.colorbars", core);
+
+    char **golden = NULL;
+    int num_golden = 0;
+    if (verify && !(golden = read_lines(verify, &num_golden)))
+    {
+        fprintf(stderr, "bench: can't read %s\n", verify);
+        return 1;
+    }
+    if (hash || verify)
+        printf("resolution,format,hdr,wcg,compatability,iq,subblack,superwhite,halfline,filter,scan,pattern,timecode,"
+               "hash0,hash1,hash2\n");
+    else
+        printf("resolution,format,hdr,wcg,compatability,iq,width,height,first_frame_ms,frames_per_s,write_mib_per_s,peak_rss_kib\n");
+    const int num_variants = hash || verify ? (int)(sizeof(variants) / sizeof(variants[0])) : 1;
+    int failed = 0;
+    for (int resolution = 0; resolution < 10; resolution++)
+    for (int depth = 0; depth < 2; depth++)
+    for (int hdr = 0; hdr < 4; hdr++)
+    for (int wcg = 0; wcg < 2; wcg++)
+    for (int compat = 0; compat < 3; compat++)
+    for (int iq = 0; iq < 4; iq++)
+    for (int v = 0; v < num_variants; v++)
+    {
+        // wcg, compatability and iq have no effect with HDR, only time the defaults
+        if (hdr && (wcg || compat != 2 || iq))
+            continue;
+        const BenchVariant *var = &variants[v];
+        if (var->sdr_format && depth)
+            continue;
+        BenchCase c = { resolution, 0, hdr, wcg, compat, iq, var->subblack, var->superwhite, var->halfline,
+                        var->filter, var->scan, var->pattern, var->timecode };
+        c.format = hdr ? (depth ? pfRGB36 : pfRGB30) : (depth ? pfYUV444P12 : pfYUV444P10);
+        if (var->sdr_format)
+            c.format = hdr ? var->hdr_format : var->sdr_format;
+        const int r = hash || verify ? run_hash(plugin, &c, golden, num_golden, vsapi)
+                                     : run_case(plugin, &c, frames, output, vsapi);
+        if (r < 0)
+            failed = 1;
+    }
+
+    // every golden case has to be rendered, one the plugin now rejects is a failure too
+    for (int i = 1; i < num_golden; i++)
+    {
+        if (golden[i][0])
+        {
+            fprintf(stderr, "bench: golden case not rendered: %s\n", golden[i]);
+            failed = 1;
+        }
+    }
+    for (int i = 0; i < num_golden; i++)
+        free(golden[i]);
+    free(golden);
+    vsapi->freeCore(core);
+    return failed;
+}
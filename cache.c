@@ -0,0 +1,253 @@
+/*****************************************************************************
+ * colorbars: a vapoursynth plugin for generating color bar test patterns
+ *****************************************************************************
+ * VapourSynth plugin
+ *     Copyright (C) 2022 Phillip Blucas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include <VapourSynth4.h>
+
+#include "colorbars.h"
+
+// Scripts often create the same bars many times over, once per output or segment.  Instances
+// whose rendered frames would be identical share one entry, which holds the frames and is freed
+// with the last instance.  Frames belong to a core, so the core is part of the key.
+
+#ifdef _WIN32
+typedef SRWLOCK CacheLock;
+#define LOCK_INIT(l) InitializeSRWLock(l)
+#define LOCK_DESTROY(l)
+#define LOCK(l) AcquireSRWLockExclusive(l)
+#define UNLOCK(l) ReleaseSRWLockExclusive(l)
+static CacheLock cache_lock = SRWLOCK_INIT;
+#else
+typedef pthread_mutex_t CacheLock;
+#define LOCK_INIT(l) pthread_mutex_init(l, NULL)
+#define LOCK_DESTROY(l) pthread_mutex_destroy(l)
+#define LOCK(l) pthread_mutex_lock(l)
+#define UNLOCK(l) pthread_mutex_unlock(l)
+static CacheLock cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+// Everything the cached frames depend on, properties included.  Built zeroed so it compares
+// with memcmp.
+typedef struct {
+    VSCore *core;
+    VSVideoInfo vi; // without the length
+    int raster_width;
+    int raster_height;
+    int left;
+    int top;
+    division_e division;
+    int subimage;
+    system_type_e resolution;
+    uint64_t layout_hash;
+    int hdr;
+    int wcg;
+    int compatability;
+    int subblack;
+    int superwhite;
+    iq_mode_e iq;
+    int halfline;
+    int filter;
+    int reference;
+    int stats;
+    int geometry;
+    scan_e scan;
+    int bff;
+} CacheKey;
+
+struct ColorBarsShared {
+    CacheKey key;
+    CacheLock lock; // held while a frame is rendered
+    const VSFrame *frame[2];
+    int ready[2]; // set with release once the frame is stored, lookups then skip the lock
+    int refs;
+    ColorBarsShared *next;
+};
+
+static ColorBarsShared *cache;
+
+static void cache_key(CacheKey *key, const ColorBarsData *d, VSCore *core)
+{
+    memset(key, 0, sizeof(*key));
+    key->core = core;
+    // field by field, a struct copy would bring the padding after numFrames along
+    key->vi.format = d->vi.format;
+    key->vi.fpsNum = d->vi.fpsNum;
+    key->vi.fpsDen = d->vi.fpsDen;
+    key->vi.width = d->vi.width;
+    key->vi.height = d->vi.height;
+    key->raster_width = d->raster_width;
+    key->raster_height = d->raster_height;
+    key->left = d->left;
+    key->top = d->top;
+    key->division = d->division;
+    key->subimage = d->subimage;
+    key->resolution = d->resolution;
+    key->layout_hash = d->layout_hash;
+    key->hdr = d->hdr;
+    key->wcg = d->wcg;
+    key->compatability = d->compatability;
+    key->subblack = d->subblack;
+    key->superwhite = d->superwhite;
+    key->iq = d->iq;
+    key->halfline = d->halfline;
+    key->filter = d->filter;
+    key->reference = d->reference;
+    key->stats = d->stats;
+    key->geometry = d->geometry;
+    key->scan = d->scan;
+    key->bff = d->bff;
+}
+
+void colorbars_share(ColorBarsData *d, VSCore *core)
+{
+    CacheKey key;
+    cache_key(&key, d, core);
+    LOCK(&cache_lock);
+    ColorBarsShared *s = cache;
+    while (s && memcmp(&s->key, &key, sizeof(key)))
+        s = s->next;
+    if (!s)
+    {
+        s = (ColorBarsShared *)calloc(1, sizeof(ColorBarsShared));
+        s->key = key;
+        LOCK_INIT(&s->lock);
+        s->next = cache;
+        cache = s;
+    }
+    s->refs++;
+    UNLOCK(&cache_lock);
+    d->shared = s;
+}
+
+void colorbars_unshare(ColorBarsData *d, const VSAPI *vsapi)
+{
+    ColorBarsShared *s = d->shared;
+    if (!s)
+        return;
+    d->shared = NULL;
+    LOCK(&cache_lock);
+    const int last = --s->refs == 0;
+    if (last)
+    {
+        ColorBarsShared **p = &cache;
+        while (*p != s)
+            p = &(*p)->next;
+        *p = s->next;
+    }
+    UNLOCK(&cache_lock);
+    if (last)
+    {
+        vsapi->freeFrame(s->frame[0]);
+        vsapi->freeFrame(s->frame[1]);
+        LOCK_DESTROY(&s->lock);
+        free(s);
+    }
+}
+
+const VSFrame *colorbars_shared_frame(const ColorBarsData *d, int field, VSCore *core, const VSAPI *vsapi)
+{
+    ColorBarsShared *s = d->shared;
+    if (!s)
+    {
+        colorbars_count_lookup(0);
+        return colorbars_render(d, field, core, vsapi);
+    }
+    if (__atomic_load_n(&s->ready[field], __ATOMIC_ACQUIRE))
+    {
+        colorbars_count_lookup(1);
+        return vsapi->addFrameRef(s->frame[field]);
+    }
+    // the first instance (or prerender) to get here renders, the others wait for it and take a reference
+    LOCK(&s->lock);
+    colorbars_count_lookup(s->frame[field] != NULL);
+    if (!s->frame[field])
+    {
+        s->frame[field] = colorbars_render(d, field, core, vsapi);
+        __atomic_store_n(&s->ready[field], 1, __ATOMIC_RELEASE);
+    }
+    const VSFrame *frame = vsapi->addFrameRef(s->frame[field]);
+    UNLOCK(&s->lock);
+    return frame;
+}
+
+struct ColorBarsPrerender {
+    const ColorBarsData *d;
+    VSCore *core;
+    const VSAPI *vsapi;
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+};
+
+#ifdef _WIN32
+static DWORD WINAPI prerender_worker(LPVOID arg)
+#else
+static void *prerender_worker(void *arg)
+#endif
+{
+    ColorBarsPrerender *p = (ColorBarsPrerender *)arg;
+    for (int field = 0; field < (p->d->scan == SCAN_FIELDS ? 2 : 1); field++)
+        p->vsapi->freeFrame(colorbars_shared_frame(p->d, field, p->core, p->vsapi));
+    return 0;
+}
+
+void colorbars_prerender(ColorBarsData *d, VSCore *core, const VSAPI *vsapi)
+{
+    ColorBarsPrerender *p = (ColorBarsPrerender *)malloc(sizeof(ColorBarsPrerender));
+    p->d = d;
+    p->core = core;
+    p->vsapi = vsapi;
+    // without a thread the first request renders, as it would without prerender
+#ifdef _WIN32
+    if (!(p->thread = CreateThread(NULL, 0, prerender_worker, p, 0, NULL)))
+#else
+    if (pthread_create(&p->thread, NULL, prerender_worker, p))
+#endif
+    {
+        free(p);
+        return;
+    }
+    d->prerender_thread = p;
+}
+
+void colorbars_prerender_join(ColorBarsData *d)
+{
+    ColorBarsPrerender *p = d->prerender_thread;
+    if (!p)
+        return;
+#ifdef _WIN32
+    WaitForSingleObject(p->thread, INFINITE);
+    CloseHandle(p->thread);
+#else
+    pthread_join(p->thread, NULL);
+#endif
+    free(p);
+    d->prerender_thread = NULL;
+}
@@ -20,800 +20,1287 @@
  *
  *****************************************************************************/
 #include <ctype.h>
+#include <limits.h>
+#include <math.h>
 #include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
 
 #include <VapourSynth4.h>
 #include <VSHelper4.h>
 #include <VSConstants4.h>
 
+#include "colorbars.h"
+
 #define RETERROR(x) do { vsapi->mapSetError(out, (x)); return; } while (0)
 
-typedef enum {
-    NTSC = 0,
-    PAL,
-    HD720,
-    HD1080,
-    DCI2K,
-    UHDTV1,
-    DCI4K,
-    UHDTV2,
-    NTSC_4FSC,
-    PAL_4FSC
-} system_type_e;
-
-typedef enum {
-    IQ_NONE = 0,
-    IQ_BOTH,
-    IQ_PLUS_I,
-    IQ_WHITE
-} iq_mode_e;
+// [wcg][bitdepth][value]
+// 0% Black, 75% Gray, 75% Yellow, 75% Cyan, 75% Green, 75% Magenta, 75% Red, 75% Blue, 0% Black
+static const uint16_t ntsc1_y[2][9] = { {   64,  721,  646,  525,  450,  335,  260,  139,   64 },
+                                        {  256, 2884, 2584, 2098, 1799, 1341, 1042,  556,  256 } };
+static const uint16_t ntsc1_u[2][9] = { {  512,  512,  176,  625,  289,  735,  399,  848,  512 },
+                                        { 2048, 2048,  704, 2502, 1158, 2938, 1594, 3392, 2048 } };
+static const uint16_t ntsc1_v[2][9] = { {  512,  512,  567,  176,  231,  793,  848,  457,  512 },
+                                        { 2048, 2048, 2267,  704,  923, 3173, 3392, 1829, 2048 } };
+
+// 0% Black, 75% Blue, 0% Black, 75% Magenta, 0% Black, 75% Cyan, 0% Black, 75% Gray, 0% Black
+static const uint16_t ntsc2_y[2][9] = { {   64,  139,   64,  335,   64,  525,   64,  721,   64 },
+                                        {  256,  556,  256, 1341,  256, 2098,  256, 2884,  256 } };
+static const uint16_t ntsc2_u[2][9] = { {  512,  848,  512,  735,  512,  625,  512,  512,  512 },
+                                        { 2048, 3392, 2048, 2938, 2048, 2502, 2048, 2048, 2048 } };
+static const uint16_t ntsc2_v[2][9] = { {  512,  457,  512,  793,  512,  176,  512,  512,  512 },
+                                        { 2048, 1829, 2048, 3173, 2048,  704, 2048, 2048, 2048 } };
+
+// Note that -I/+Q will be invalid if converted to RGB
+// 0% Black, -I, 100% White, +Q, 0% Black, -4% Black, 0% Black, +4% Black, 0% Black, 0% Black
+static const uint16_t ntsc3_y[2][10] = { { 64,     64,  940,   64,   64,   29,   64,   99,   64,   64 },
+                                         { 256,   256, 3760,  256,  256,  116,  256,  396,  256,  256 } };
+static const uint16_t ntsc3_u[2][10] = { { 512,   633,  512,  698,  512,  512,  512,  512,  512,  512 },
+                                         { 2048, 2532, 2048, 2793, 2048, 2048, 2048, 2048, 2048, 2048 } };
+static const uint16_t ntsc3_v[2][10] = { { 512,   380,  512,  598,  512,  512,  512,  512,  512,  512 },
+                                         { 2048, 1520, 2048, 2391, 2048, 2048, 2048, 2048, 2048, 2048 } };
+
+// 0% Black, 100% White, 75% Yellow, 75% Cyan, 75% Green, 75% Magenta, 75% Red, 75% Blue, 0% Black, 0% Black
+static const uint16_t pal_y[2][10] = { { 64,    940,  646,  525,  450,  335,  260,  139,   64,   64 },
+                                       { 256,  3760, 2584, 2098, 1799, 1341, 1042,  556,  256,  256 } };
+static const uint16_t pal_u[2][10] = { { 512,   512,  176,  625,  289,  735,  399,  848,  512,  512 },
+                                       { 2048, 2048,  704, 2502, 1158, 2938, 1594, 3392, 2048, 2048 } };
+static const uint16_t pal_v[2][10] = { { 512,   512,  567,  176,  231,  793,  848,  457,  512,  512 },
+                                       { 2048, 2048, 2267,  704,  923, 3173, 3392, 1829, 2048, 2048 } };
+
+// 40% Gray, 75% White, 75% Yellow, 75% Cyan, 75% Green, 75% Magenta, 75% Red, 75% Blue, 40% Gray
+static const uint16_t p1_y[2][2][9] = { { {  414,  721,  674,  581,  534,  251,  204,  111,  414 },
+                                          { 1658, 2884, 2694, 2325, 2136, 1004,  815,  446, 1658 } },
+                                        { {  414,  721,  682,  548,  509,  276,  237,  103,  414 },
+                                          { 1658, 2884, 2728, 2194, 2038, 1102,  946,  412, 1658 } } };
+static const uint16_t p1_u[2][2][9] = { { {  512,  512,  176,  589,  253,  771,  435,  848,  512 },
+                                          { 2048, 2048,  704, 2356, 1012, 3084, 1740, 3392, 2048 } },
+                                        { {  512,  512,  176,  606,  270,  754,  418,  848,  512 },
+                                          { 2048, 2048,  704, 2423, 1079, 3017, 1673, 3392, 2048 } } };
+static const uint16_t p1_v[2][2][9] = { { {  512,  512,  543,  176,  207,  817,  848,  481,  512 },
+                                          { 2048, 2048, 2171,  704,  827, 3269, 3392, 1925, 2048 } },
+                                        { {  512,  512,  539,  176,  203,  821,  848,  485,  512 },
+                                          { 2048, 2048, 2156,  704,  812, 3284, 3392, 1940, 2048 } } };
+
+// 100% Cyan, 100% White, 75% White (x6), 100% Blue, -I, +I, 75% White
+static const uint16_t p2_y[2][2][12] = { { {  754,  940,  721,  721,  721,  721,  721,  721,  127,  244,  245,  721 },
+                                           { 3015, 3760, 2884, 2884, 2884, 2884, 2884, 2884,  509,  976,  982, 2884 } },
+                                         { {  710,  940,  721,  721,  721,  721,  721,  721,  116,    0,    0,  721 },
+                                           { 2839, 3760, 2884, 2884, 2884, 2884, 2884, 2884,  464,    0,    0, 2884 } } };
+static const uint16_t p2_u[2][2][12] = { { {  615,  512,  512,  512,  512,  512,  512,  512,  960,  612,  412,  512 },
+                                           { 2459, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 3840, 2448, 1648, 2048 } },
+                                         { {  637,  512,  512,  512,  512,  512,  512,  512,  960,    0,    0,  512 },
+                                           { 2548, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 3840,    0,    0, 2048 } } };
+static const uint16_t p2_v[2][2][12] = { { {   64,  512,  512,  512,  512,  512,  512,  512,  471,  395,  629,  512 },
+                                           {  256, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 1884, 1580, 2516, 2048 } },
+                                         { {   64,  512,  512,  512,  512,  512,  512,  512,  476,    0,    0,  512 },
+                                           {  256, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 1904,    0,    0, 2048 } } };
+
+// 100% Yellow, 0% Black (x5), Ramp 100%, 100% White, 100% Red, +Q
+static const uint16_t p3_y[2][2][10] = { { {  877,   64,   64,   64,   64,   64,  940,  940,  250,  141 },
+                                           { 3507,  256,  256,  256,  256,  256, 3760, 3760, 1001,  564 } },
+                                         { {  888,   64,   64,   64,   64,   64,  940,  940,  294,    0 },
+                                           { 3552,  256,  256,  256,  256,  256, 3760, 3760, 1177,    0 } } };
+static const uint16_t p3_u[2][2][10] = { { {   64,  512,  512,  512,  512,  512,  512,  512,  409,  697 },
+                                           {  256, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 1637, 2787 } },
+                                         { {   64,  512,  512,  512,  512,  512,  512,  512,  387,    0 },
+                                           {  256, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 1548,    0 } } };
+static const uint16_t p3_v[2][2][10] = { { {  553,  512,  512,  512,  512,  512,  512,  512,  960,  606 },
+                                           { 2212, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 3840, 2425 } },
+                                         { {  548,  512,  512,  512,  512,  512,  512,  512,  960,    0 },
+                                           { 2192, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 3840,    0 } } };
+
+// 15% Gray, 0% Black, 100% White, 0% Black, -2% Black, 0% Black, 2% Black, 0% Black, 4% Black, 0% Black, 15% Gray, Sub-black Valley, Super-white Peak
+static const uint16_t p4_y[2][13] = { {  195,   64,  940,   64,   46,   64,   82,   64,   99,   64,  195,    4, 1019 },
+                                      {  782,  256, 3760,  256,  186,  256,  326,  256,  396,  256,  782,   16, 4079 } };
+static const uint16_t p4_u[2][13] = { {  512,  512,  512,  512,  512,  512,  512,  512,  512,  512,  512,  512,  512 },
+                                      { 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048 } };
+static const uint16_t p4_v[2][13] = { {  512,  512,  512,  512,  512,  512,  512,  512,  512,  512,  512,  512,  512 },
+                                      { 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048 } };
+
+// 525-line Systems: 710.85x484 and 2 half lines ~ 711x486
+// 625-line Systems: 702x574 and 2 half lines ~ 702x576
+// EG-1 1990
+// http://xpt.sourceforge.net/techdocs/media/video/dvd/dvd04-DVDAuthoringSpecwise/ar01s02.html
+// https://forum.doom9.org/showpost.php?p=1686753&postcount=17
+
+// [compatability][pattern height]
+static const int ntsc_heights[3][4] = { { 324, 41, 121, 486 },
+                                        { 324, 40, 122, 486 },
+                                        { 320, 40, 120, 480 } };
+
+// [hdr system][bitdepth][value]
+static const uint16_t hdr_p1_r[3][2][9] = { { {  414,  940,  940,   64,   64,  940,  940,   64,  414 },
+                                              { 1656, 3760, 3760,  256,  256, 3760, 3760,  256, 1656 } },
+                                            { {  414,  940,  940,   64,   64,  940,  940,   64,  414 },
+                                              { 1656, 3760, 3760,  256,  256, 3760, 3760,  256, 1656 } },
+                                            { {  409, 1023, 1023,    0,    0, 1023, 1023,    0,  409 },
+                                              { 1638, 4095, 4095,    0,    0, 4095, 4095,    0, 1638 } } };
+static const uint16_t hdr_p1_g[3][2][9] = { { {  414,  940,  940,  940,  940,   64,   64,   64,  414 },
+                                              { 1656, 3760, 3760, 3760, 3760,  256,  256,  256, 1656 } },
+                                            { {  414,  940,  940,  940,  940,   64,   64,   64,  414 },
+                                              { 1656, 3760, 3760, 3760, 3760,  256,  256,  256, 1656 } },
+                                            { { 409, 1023, 1023,  1023, 1023,    0,    0,    0,  409 },
+                                              { 1638, 4095, 4095, 4095, 4095,    0,    0,    0, 1638 } } };
+static const uint16_t hdr_p1_b[3][2][9] = { { {  414,  940,   64,  940,   64,  940,   64,  940,  414 },
+                                              { 1656, 3760,  256, 3760,  256, 3760,  256, 3760, 1656 } },
+                                            { {  414,  940,   64,  940,   64,  940,   64,  940,  414 },
+                                              { 1656, 3760,  256, 3760,  256, 3760,  256, 3760, 1656 } },
+                                            { {  409, 1023,    0, 1023,    0, 1023,    0, 1023,  409 },
+                                              { 1638, 4095,    0, 4095,    0, 4095,    0, 4095, 1638 } } };
+
+static const uint16_t hdr_p2_r[3][2][9] = { { {  414,  721,  721,   64,   64,  721,  721,   64,  414 },
+                                              { 1656, 2884, 2884,  256,  256, 2884, 2884,  256, 1656 } },
+                                            { {  414,  572,  572,   64,   64,  572,  572,   64,  414 },
+                                              { 1656, 2288, 2288,  256,  256, 2288, 2288,  256, 1656 } },
+                                            { {  409,  593,  593,    0,    0,  593,  593,    0,  409 },
+                                              { 1638, 2375, 2375,    0,    0, 2375, 2375,    0, 1638 } } };
+static const uint16_t hdr_p2_g[3][2][9] = { { {  414,  721,  721,  721,  721,   64,   64,   64,  414 },
+                                              { 1656, 2884, 2884, 2884, 2884,  256,  256,  256, 1656 } },
+                                            { {  414,  572,  572,  572,  572,   64,   64,   64,  414 },
+                                              { 1656, 2288, 2288, 2288, 2288,  256,  256,  256, 1656 } },
+                                            { {  409,  593,  593,  593,  593,    0,    0,    0,  409 },
+                                              { 1638, 2375, 2375, 2375, 2375,    0,    0,    0, 1638 } } };
+static const uint16_t hdr_p2_b[3][2][9] = { { {  414,  721,   64,  721,   64,  721,   64,  721,  414 },
+                                              { 1656, 2884,  256, 2884,  256, 2884,  256, 2884, 1656 } },
+                                            { {  414,  572,   64,  572,   64,  572,   64,  572,  414 },
+                                              { 1656, 2288,  256, 2288,  256, 2288,  256, 2288, 1656 } },
+                                            { {  409,  593,    0,  593,    0,  593,    0,  593,  409 },
+                                              { 1638, 2375,    0, 2375,    0, 2375,    0, 2375, 1638 } } };
 
+static const uint16_t hdr_p3_gray[3][2][15] = { { {  721,    4,   64,  152,  239,  327,  414,  502,  590,  677,  765,  852,  940, 1019,  721 },
+                                                  { 2884,   16,  256,  608,  956, 1308, 1656, 2008, 2360, 2708, 3060, 3408, 3760, 4076, 2884 } },
+                                                { {  572,    4,   64,  152,  239,  327,  414,  502,  590,  677,  765,  852,  940, 1019,  572 },
+                                                  { 2288,   16,  256,  608,  956, 1308, 1656, 2008, 2360, 2708, 3060, 3408, 3760, 4076, 2288 } },
+                                                { {  593,    0,    0,  102,  205,  307,  409,  512,  614,  716,  818,  921, 1023, 1023,  593 },
+                                                  { 2375,    0,    0,  410,  819, 1229, 1638, 2048, 2457, 2867, 3276, 3686, 4095, 4095, 2375 } } };
+
+static const uint16_t hdr_p4_gray[3][2][3] = { { {  64,   4, 1019 },
+                                                 { 256,  16, 4079 } },
+                                               { {  64,   4, 1019 },
+                                                 { 256,  16, 4079 } },
+                                               { {   0,   0, 1023 },
+                                                 {   0,   0, 4095 } } };
+
+static const uint16_t hdr_p5_r[3][2][15] = { { {  713,  538,  512,   64,   48,   64,   80,   64,   99,   64,  721,   64,  651,  639,  227 },
+                                               { 2852, 2152, 2048,  256,  192,  256,  320,  256,  396,  256, 2884,  256, 2604, 2556,  908 } },
+                                             { {  568,  484,  474,   64,   48,   64,   80,   64,   99,   64,  572,   64,  536,  530,  317 },
+                                               { 2272, 1936, 1896,  256,  192,  256,  320,  256,  396,  256, 2288,  256, 2144, 2120, 1268 } },
+                                             { {  589,  491,  478,    0,    0,    0,   20,    0,   41,    0,  593,    0,  551,  544,  296 },
+                                               { 2356, 1964, 1915,    0,    0,    0,   82,    0,  164,    0, 2375,    0, 2206, 2178, 1184 } } };
+static const uint16_t hdr_p5_g[3][2][15] = { { {  719,  709,  706,   64,   48,   64,   80,   64,   99,   64,  721,   64,  286,  269,  147 },
+                                               { 2876, 2836, 2824,  256,  192,  256,  320,  256,  396,  256, 2884,  256, 1144, 1076,  588 } },
+                                             { {  571,  566,  564,   64,   48,   64,   80,   64,   99,   64,  572,   64,  361,  350,  236 },
+                                               { 2284, 2264, 2256,  256,  192,  256,  320,  256,  396,  256, 2288,  256, 1444, 1400,  944 } },
+                                             { {  592,  586,  584,    0,    0,    0,   20,    0,   41,    0,  593,    0,  347,  334,  201 },
+                                               { 2370, 2345, 2339,    0,    0,    0,   82,    0,  164,    0, 2375,    0, 1389, 1337,  805 } } };
+static const uint16_t hdr_p5_b[3][2][15] = { { {  316,  718,  296,   64,   48,   64,   80,   64,   99,   64,  721,   64,  705,  164,  702 },
+                                               { 1264, 2872, 1184,  256,  192,  256,  320,  256,  396,  256, 2884,  256, 2820,  656, 2808 } },
+                                             { {  381,  571,  368,   64,   48,   64,   80,   64,   99,   64,  572,   64,  564,  256,  562 },
+                                               { 1524, 2284, 1472,  256,  192,  256,  320,  256,  396,  256, 2288,  256, 2256, 1024, 2248 } },
+                                             { {  370,  592,  355,    0,    0,    0,   20,    0,   41,    0,  593,    0,  584,  225,  582 },
+                                               { 1480, 2368, 1420,    0,    0,    0,   82,    0,  164,    0, 2375,    0, 2336,  900, 2328 } } };
+
+// [resolution][compatability][bar width]
+static const int p1_widths[10][3][10] = { { {   4, 101, 102, 102, 102, 102, 102, 101,   4 }, // 525-line (NTSC BT.601)
+                                            {   4, 102, 102, 102, 100, 102, 102, 102,   4 },
+                                            {   0, 104, 102, 102, 102, 104, 102, 104,   0 } },
+                                          { {   9,  87,  88,  88,  88,  88,  88,  88,  87,   9 }, // 625-line (PAL BT.601)
+                                            {   8,  88,  88,  88,  88,  88,  88,  88,  88,   8 },
+                                            {   0,  90,  90,  90,  90,  90,  90,  90,  90,   0 } },
+                                          { { 160, 137, 137, 137, 138, 137, 137, 137, 160 }, // 720
+                                            { 160, 138, 136, 138, 136, 138, 136, 138, 160 },
+                                            { 156, 142, 136, 138, 136, 138, 136, 142, 156 } },
+                                          { { 240, 205, 206, 206, 206, 206, 206, 205, 240 }, // 1080
+                                            { 240, 206, 206, 206, 204, 206, 206, 206, 240 },
+                                            { 236, 210, 206, 206, 204, 206, 206, 210, 236 } },
+                                          { { 304, 205, 206, 206, 206, 206, 206, 205, 304 }, // 2K
+                                            { 304, 206, 206, 206, 204, 206, 206, 206, 304 },
+                                            { 300, 210, 206, 206, 204, 206, 206, 210, 300 } },
+                                          { { 480, 410, 412, 412, 412, 412, 412, 410, 480 }, // UHD
+                                            { 480, 412, 412, 412, 410, 412, 412, 412, 480 },
+                                            { 472, 420, 412, 412, 408, 412, 412, 420, 472 } },
+                                          { { 608, 410, 412, 412, 412, 412, 412, 410, 608 }, // 4K
+                                            { 608, 412, 412, 412, 410, 412, 412, 412, 608 },
+                                            { 600, 420, 412, 412, 408, 412, 412, 420, 600 } },
+                                          { { 960, 820, 824, 824, 824, 824, 824, 820, 960 }, // 8K
+                                            { 960, 824, 824, 824, 816, 824, 824, 824, 960 },
+                                            { 944, 840, 824, 824, 816, 824, 824, 840, 944 } },
+                                          { {   5, 109, 108, 108, 108, 108, 108, 109,   5 }, // 525-line (NTSC 4fsc)
+                                            {   4, 110, 108, 108, 108, 108, 108, 110,   4 },
+                                            {   0, 108, 110, 110, 112, 110, 110, 108,   0 } },
+                                          { {  12, 117, 115, 115, 115, 115, 115, 115, 117, 12 }, // 625-line (PAL 4fsc)
+                                            {  12, 116, 116, 116, 114, 114, 116, 116, 116, 12 },
+                                            {   0, 120, 118, 118, 118, 118, 118, 118, 120,  0 } } };
+
+// [resolution][compatability][bar width]
+static const int p4_widths[10][3][11] = { { {   4, 127, 128, 127, 128,  34,  34,  34, 101,   4,   0 }, // 525-line (NTSC BT.601)
+                                            {   4, 126, 128, 126, 128,  34,  34,  34, 102,   4,   0 },
+                                            {   0, 128, 130, 128, 128,  34,  34,  34, 104,   0,   0 } },
+                                          { {   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 }, // 625-line (PAL BT.601)
+                                            {   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 },
+                                            {   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 } },
+                                          { { 160, 206, 274, 115,  46,  45,  46,  46,  45, 137, 160 }, // 720
+                                            { 160, 206, 274, 116,  46,  44,  46,  46,  44, 138, 160 },
+                                            { 156, 210, 274, 116,  46,  44,  46,  46,  44, 142, 156 } },
+                                          { { 240, 309, 411, 171,  69,  68,  69,  68,  69, 206, 240 }, // 1080
+                                            { 240, 308, 412, 170,  68,  70,  68,  70,  68, 206, 240 },
+                                            { 236, 312, 412, 170,  68,  70,  68,  70,  68, 210, 236 } },
+                                          { { 304, 309, 411, 171,  69,  68,  69,  68,  69, 206, 304 }, // 2K
+                                            { 304, 308, 412, 170,  68,  70,  68,  70,  68, 206, 304 },
+                                            { 300, 312, 412, 170,  68,  70,  68,  70,  68, 210, 300 } },
+                                          { { 480, 618, 822, 342, 138, 136, 138, 136, 138, 412, 480 }, // UHD
+                                            { 480, 616, 824, 340, 136, 140, 136, 140, 136, 412, 480 },
+                                            { 472, 624, 824, 340, 136, 140, 136, 140, 136, 420, 472 } },
+                                          { { 608, 618, 822, 342, 138, 136, 138, 136, 138, 412, 608 }, // 4K
+                                            { 608, 616, 824, 340, 136, 140, 136, 140, 136, 412, 608 },
+                                            { 600, 624, 824, 340, 136, 140, 136, 140, 136, 420, 600 } },
+                                          { { 960, 1236,1644,684, 276, 272, 276, 272, 276, 824, 960 }, // 8K
+                                            { 960, 1232,1648,680, 272, 280, 272, 280, 272, 824, 960 },
+                                            { 944, 1248,1648,680, 272, 280, 272, 280, 272, 840, 944 } },
+                                          { {   5, 136, 135, 135, 135,  36,  36,  36, 109,   5,   0 }, // 525-line (NTSC 4fsc)
+                                            {   4, 136, 136, 136, 136,  36,  36,  36, 110,   4,   0 },
+                                            {   0, 138, 138, 138, 136,  36,  38,  36, 108,   0,   0 } },
+                                          { {   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 }, // 625-line (PAL 4fsc)
+                                            {   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 },
+                                            {   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 } } };
+
+// [resolution][bar width]
+static const int hdr_p1_widths[5][9] = { { 240, 206, 206, 206, 204, 206, 206, 206, 240 },   // 1080
+                                         { 304, 206, 206, 206, 204, 206, 206, 206, 304 },   // 2K
+                                         { 480, 412, 412, 412, 408, 412, 412, 412, 480 },   // UHD
+                                         { 608, 412, 412, 412, 408, 412, 412, 412, 608 },   // 4K
+                                         { 960, 824, 824, 824, 816, 824, 824, 824, 960 } }; // 8K
+
+static const int hdr_p3_widths[5][15] = { { 240, 206, 103, 103, 103, 103, 102, 102, 103, 103, 103, 103, 103, 103, 240 },   // 1080
+                                          { 304, 206, 103, 103, 103, 103, 102, 102, 103, 103, 103, 103, 103, 103, 304 },   // 2K
+                                          { 480, 412, 206, 206, 206, 206, 204, 204, 206, 206, 206, 206, 206, 206, 480 },   // UHD
+                                          { 608, 412, 206, 206, 206, 206, 204, 204, 206, 206, 206, 206, 206, 206, 608 },   // 4K
+                                          { 960, 824, 412, 412, 412, 412, 408, 408, 412, 412, 412, 412, 412, 412, 960 } }; // 8K
+
+// [depth][hdr system][resolution][bar width]
+static const int hdr_p4_widths[2][3][5][4] = { { { {  240,  559, 1014,  107 }, // HLG 10-bit
+                                                   {  304,  559, 1014,  171 },
+                                                   {  480, 1118, 2028,  214 },
+                                                   {  608, 1118, 2028,  342 },
+                                                   {  960, 2236, 4056,  428 } } ,
+                                                 { {  240,  559, 1014,  107 }, // PQ 10-bit
+                                                   {  304,  559, 1014,  171 },
+                                                   {  480, 1118, 2028,  214 },
+                                                   {  608, 1118, 2028,  342 },
+                                                   {  960, 2236, 4056,  428 } } ,
+                                                 { {  240,  551, 1022,  107 }, // PQ full range 10-bit
+                                                   {  304,  551, 1022,  171 },
+                                                   {  480, 1102, 2044,  214 },
+                                                   {  608, 1102, 2044,  342 },
+                                                   {  960, 2204, 4088,  428 } } } ,
+                                               { { {  240,  559, 1015,  106 }, // HLG 12-bit
+                                                   {  304,  559, 1015,  170 },
+                                                   {  480, 1117, 2031,  212 },
+                                                   {  608, 1117, 2031,  340 },
+                                                   {  960, 2233, 4062,  425 } } ,
+                                                 { {  240,  559, 1015,  106 }, // PQ 12-bit
+                                                   {  304,  559, 1015,  170 },
+                                                   {  480, 1117, 2031,  212 },
+                                                   {  608, 1117, 2031,  340 },
+                                                   {  960, 2233, 4062,  425 } } ,
+                                                 { {  240,  551, 1023,  106 }, // PQ full range 12-bit
+                                                   {  304,  551, 1023,  170 },
+                                                   {  480, 1101, 2047,  212 },
+                                                   {  608, 1101, 2047,  340 },
+                                                   {  960, 2201, 4094,  425 } } } };
+
+static const int hdr_p5_widths[5][15] = { {  80,   80,   80,  136,   70,   68,   70,   68,   70,  238,  438,  282,   80,   80,   80 },   // 1080
+                                          { 144,   80,   80,  136,   70,   68,   70,   68,   70,  238,  438,  282,   80,   80,  144 },   // 2K
+                                          { 160,  160,  160,  272,  140,  136,  140,  136,  140,  476,  876,  564,  160,  160,  160 },   // UHD
+                                          { 288,  160,  160,  272,  140,  136,  140,  136,  140,  476,  876,  564,  160,  160,  288 },   // 4K
+                                          { 320,  320,  320,  544,  280,  272,  280,  272,  280,  952, 1752, 1128,  320,  320,  320 } }; // 8K
+
+// Bar widths and band heights of the HD and higher layouts, from the tables above for the
+// standard rasters or scaled to any other.
 typedef struct {
-    VSVideoInfo vi;
-    system_type_e resolution;
-    int hdr;
-    int wcg;
-    int compatability;
-    int subblack;
-    int superwhite;
-    iq_mode_e iq;
-    int halfline;
-    int filter;
-} ColorBarsData;
+    int p1[9];       // SDR patterns 1 to 3, HDR patterns 1 and 2
+    int p4[11];      // SDR pattern 4
+    int hdr_p3[15];
+    int hdr_p4[4];
+    int hdr_p5[15];
+    int rows[6];     // band heights, top to bottom
+} BarGeometry;
 
-static const VSFrame *VS_CC colorbarsGetFrame (int n, int activationReason, void* instanceData, void** frameData, VSFrameContext* frameCtx, VSCore* core, const VSAPI* vsapi)
+static void table_geometry(const ColorBarsData *d, BarGeometry *g)
 {
-    ColorBarsData *d = (ColorBarsData*)instanceData;
-    if (activationReason == arInitial)
+    const int resolution = d->resolution;
+    const int compat = d->compatability;
+    const int hdr = d->hdr;
+    const int depth = d->vi.format.bitsPerSample <= 10 ? 0 : 1;
+    const int height = d->vi.height;
+
+    if (hdr)
     {
-        // [wcg][bitdepth][value]
-        // 0% Black, 75% Gray, 75% Yellow, 75% Cyan, 75% Green, 75% Magenta, 75% Red, 75% Blue, 0% Black
-        const uint16_t ntsc1_y[2][9] = { {   64,  721,  646,  525,  450,  335,  260,  139,   64 },
-                                         {  256, 2884, 2584, 2098, 1799, 1341, 1042,  556,  256 } };
-        const uint16_t ntsc1_u[2][9] = { {  512,  512,  176,  625,  289,  735,  399,  848,  512 },
-                                         { 2048, 2048,  704, 2502, 1158, 2938, 1594, 3392, 2048 } };
-        const uint16_t ntsc1_v[2][9] = { {  512,  512,  567,  176,  231,  793,  848,  457,  512 },
-                                         { 2048, 2048, 2267,  704,  923, 3173, 3392, 1829, 2048 } };
-
-        // 0% Black, 75% Blue, 0% Black, 75% Magenta, 0% Black, 75% Cyan, 0% Black, 75% Gray, 0% Black
-        const uint16_t ntsc2_y[2][9] = { {   64,  139,   64,  335,   64,  525,   64,  721,   64 },
-                                         {  256,  556,  256, 1341,  256, 2098,  256, 2884,  256 } };
-        const uint16_t ntsc2_u[2][9] = { {  512,  848,  512,  735,  512,  625,  512,  512,  512 },
-                                         { 2048, 3392, 2048, 2938, 2048, 2502, 2048, 2048, 2048 } };
-        const uint16_t ntsc2_v[2][9] = { {  512,  457,  512,  793,  512,  176,  512,  512,  512 },
-                                         { 2048, 1829, 2048, 3173, 2048,  704, 2048, 2048, 2048 } };
-
-        // Note that -I/+Q will be invalid if converted to RGB
-        // 0% Black, -I, 100% White, +Q, 0% Black, -4% Black, 0% Black, +4% Black, 0% Black, 0% Black
-        const uint16_t ntsc3_y[2][10] = { { 64,     64,  940,   64,   64,   29,   64,   99,   64,   64 },
-                                          { 256,   256, 3760,  256,  256,  116,  256,  396,  256,  256 } };
-        const uint16_t ntsc3_u[2][10] = { { 512,   633,  512,  698,  512,  512,  512,  512,  512,  512 },
-                                          { 2048, 2532, 2048, 2793, 2048, 2048, 2048, 2048, 2048, 2048 } };
-        const uint16_t ntsc3_v[2][10] = { { 512,   380,  512,  598,  512,  512,  512,  512,  512,  512 },
-                                          { 2048, 1520, 2048, 2391, 2048, 2048, 2048, 2048, 2048, 2048 } };
-
-        // 0% Black, 100% White, 75% Yellow, 75% Cyan, 75% Green, 75% Magenta, 75% Red, 75% Blue, 0% Black, 0% Black
-        const uint16_t pal_y[2][10] = { { 64,    940,  646,  525,  450,  335,  260,  139,   64,   64 },
-                                        { 256,  3760, 2584, 2098, 1799, 1341, 1042,  556,  256,  256 } };
-        const uint16_t pal_u[2][10] = { { 512,   512,  176,  625,  289,  735,  399,  848,  512,  512 },
-                                        { 2048, 2048,  704, 2502, 1158, 2938, 1594, 3392, 2048, 2048 } };
-        const uint16_t pal_v[2][10] = { { 512,   512,  567,  176,  231,  793,  848,  457,  512,  512 },
-                                        { 2048, 2048, 2267,  704,  923, 3173, 3392, 1829, 2048, 2048 } };
-
-        // 40% Gray, 75% White, 75% Yellow, 75% Cyan, 75% Green, 75% Magenta, 75% Red, 75% Blue, 40% Gray
-        const uint16_t p1_y[2][2][9] = { { {  414,  721,  674,  581,  534,  251,  204,  111,  414 },
-                                           { 1658, 2884, 2694, 2325, 2136, 1004,  815,  446, 1658 } },
-                                         { {  414,  721,  682,  548,  509,  276,  237,  103,  414 },
-                                           { 1658, 2884, 2728, 2194, 2038, 1102,  946,  412, 1658 } } };
-        const uint16_t p1_u[2][2][9] = { { {  512,  512,  176,  589,  253,  771,  435,  848,  512 },
-                                           { 2048, 2048,  704, 2356, 1012, 3084, 1740, 3392, 2048 } },
-                                         { {  512,  512,  176,  606,  270,  754,  418,  848,  512 },
-                                           { 2048, 2048,  704, 2423, 1079, 3017, 1673, 3392, 2048 } } };
-        const uint16_t p1_v[2][2][9] = { { {  512,  512,  543,  176,  207,  817,  848,  481,  512 },
-                                           { 2048, 2048, 2171,  704,  827, 3269, 3392, 1925, 2048 } },
-                                         { {  512,  512,  539,  176,  203,  821,  848,  485,  512 },
-                                           { 2048, 2048, 2156,  704,  812, 3284, 3392, 1940, 2048 } } };
-
-        // 100% Cyan, 100% White, 75% White (x6), 100% Blue, -I, +I, 75% White
-        const uint16_t p2_y[2][2][12] = { { {  754,  940,  721,  721,  721,  721,  721,  721,  127,  244,  245,  721 },
-                                            { 3015, 3760, 2884, 2884, 2884, 2884, 2884, 2884,  509,  976,  982, 2884 } },
-                                          { {  710,  940,  721,  721,  721,  721,  721,  721,  116,    0,    0,  721 },
-                                            { 2839, 3760, 2884, 2884, 2884, 2884, 2884, 2884,  464,    0,    0, 2884 } } };
-        const uint16_t p2_u[2][2][12] = { { {  615,  512,  512,  512,  512,  512,  512,  512,  960,  612,  412,  512 },
-                                            { 2459, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 3840, 2448, 1648, 2048 } },
-                                          { {  637,  512,  512,  512,  512,  512,  512,  512,  960,    0,    0,  512 },
-                                            { 2548, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 3840,    0,    0, 2048 } } };
-        const uint16_t p2_v[2][2][12] = { { {   64,  512,  512,  512,  512,  512,  512,  512,  471,  395,  629,  512 },
-                                            {  256, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 1884, 1580, 2516, 2048 } },
-                                          { {   64,  512,  512,  512,  512,  512,  512,  512,  476,    0,    0,  512 },
-                                            {  256, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 1904,    0,    0, 2048 } } };
-
-        // 100% Yellow, 0% Black (x5), Ramp 100%, 100% White, 100% Red, +Q
-        const uint16_t p3_y[2][2][10] = { { {  877,   64,   64,   64,   64,   64,  940,  940,  250,  141 },
-                                            { 3507,  256,  256,  256,  256,  256, 3760, 3760, 1001,  564 } },
-                                          { {  888,   64,   64,   64,   64,   64,  940,  940,  294,    0 },
-                                            { 3552,  256,  256,  256,  256,  256, 3760, 3760, 1177,    0 } } };
-        const uint16_t p3_u[2][2][10] = { { {   64,  512,  512,  512,  512,  512,  512,  512,  409,  697 },
-                                            {  256, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 1637, 2787 } },
-                                          { {   64,  512,  512,  512,  512,  512,  512,  512,  387,    0 },
-                                            {  256, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 1548,    0 } } };
-        const uint16_t p3_v[2][2][10] = { { {  553,  512,  512,  512,  512,  512,  512,  512,  960,  606 },
-                                            { 2212, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 3840, 2425 } },
-                                          { {  548,  512,  512,  512,  512,  512,  512,  512,  960,    0 },
-                                            { 2192, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 3840,    0 } } };
-
-        // 15% Gray, 0% Black, 100% White, 0% Black, -2% Black, 0% Black, 2% Black, 0% Black, 4% Black, 0% Black, 15% Gray, Sub-black Valley, Super-white Peak
-        const uint16_t p4_y[2][13] = { {  195,   64,  940,   64,   46,   64,   82,   64,   99,   64,  195,    4, 1019 },
-                                       {  782,  256, 3760,  256,  186,  256,  326,  256,  396,  256,  782,   16, 4079 } };
-        const uint16_t p4_u[2][13] = { {  512,  512,  512,  512,  512,  512,  512,  512,  512,  512,  512,  512,  512 },
-                                       { 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048 } };
-        const uint16_t p4_v[2][13] = { {  512,  512,  512,  512,  512,  512,  512,  512,  512,  512,  512,  512,  512 },
-                                       { 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048 } };
-
-        // 525-line Systems: 710.85x484 and 2 half lines ~ 711x486
-        // 625-line Systems: 702x574 and 2 half lines ~ 702x576
-        // EG-1 1990
-        // http://xpt.sourceforge.net/techdocs/media/video/dvd/dvd04-DVDAuthoringSpecwise/ar01s02.html
-        // https://forum.doom9.org/showpost.php?p=1686753&postcount=17
-
-        // [compatability][pattern height]
-        const int ntsc_heights[3][4] = { { 324, 41, 121, 486 },
-                                         { 324, 40, 122, 486 },
-                                         { 320, 40, 120, 480 } };
-
-        // [hdr system][bitdepth][value]
-        const uint16_t hdr_p1_r[3][2][9] = { { {  414,  940,  940,   64,   64,  940,  940,   64,  414 },
-                                               { 1656, 3760, 3760,  256,  256, 3760, 3760,  256, 1656 } },
-                                             { {  414,  940,  940,   64,   64,  940,  940,   64,  414 },
-                                               { 1656, 3760, 3760,  256,  256, 3760, 3760,  256, 1656 } },
-                                             { {  409, 1023, 1023,    0,    0, 1023, 1023,    0,  409 },
-                                               { 1638, 4095, 4095,    0,    0, 4095, 4095,    0, 1638 } } };
-        const uint16_t hdr_p1_g[3][2][9] = { { {  414,  940,  940,  940,  940,   64,   64,   64,  414 },
-                                               { 1656, 3760, 3760, 3760, 3760,  256,  256,  256, 1656 } },
-                                             { {  414,  940,  940,  940,  940,   64,   64,   64,  414 },
-                                               { 1656, 3760, 3760, 3760, 3760,  256,  256,  256, 1656 } },
-                                             { { 409, 1023, 1023,  1023, 1023,    0,    0,    0,  409 },
-                                               { 1638, 4095, 4095, 4095, 4095,    0,    0,    0, 1638 } } };
-        const uint16_t hdr_p1_b[3][2][9] = { { {  414,  940,   64,  940,   64,  940,   64,  940,  414 },
-                                               { 1656, 3760,  256, 3760,  256, 3760,  256, 3760, 1656 } },
-                                             { {  414,  940,   64,  940,   64,  940,   64,  940,  414 },
-                                               { 1656, 3760,  256, 3760,  256, 3760,  256, 3760, 1656 } },
-                                             { {  409, 1023,    0, 1023,    0, 1023,    0, 1023,  409 },
-                                               { 1638, 4095,    0, 4095,    0, 4095,    0, 4095, 1638 } } };
-
-        const uint16_t hdr_p2_r[3][2][9] = { { {  414,  721,  721,   64,   64,  721,  721,   64,  414 },
-                                               { 1656, 2884, 2884,  256,  256, 2884, 2884,  256, 1656 } },
-                                             { {  414,  572,  572,   64,   64,  572,  572,   64,  414 },
-                                               { 1656, 2288, 2288,  256,  256, 2288, 2288,  256, 1656 } },
-                                             { {  409,  593,  593,    0,    0,  593,  593,    0,  409 },
-                                               { 1638, 2375, 2375,    0,    0, 2375, 2375,    0, 1638 } } };
-        const uint16_t hdr_p2_g[3][2][9] = { { {  414,  721,  721,  721,  721,   64,   64,   64,  414 },
-                                               { 1656, 2884, 2884, 2884, 2884,  256,  256,  256, 1656 } },
-                                             { {  414,  572,  572,  572,  572,   64,   64,   64,  414 },
-                                               { 1656, 2288, 2288, 2288, 2288,  256,  256,  256, 1656 } },
-                                             { {  409,  593,  593,  593,  593,    0,    0,    0,  409 },
-                                               { 1638, 2375, 2375, 2375, 2375,    0,    0,    0, 1638 } } };
-        const uint16_t hdr_p2_b[3][2][9] = { { {  414,  721,   64,  721,   64,  721,   64,  721,  414 },
-                                               { 1656, 2884,  256, 2884,  256, 2884,  256, 2884, 1656 } },
-                                             { {  414,  572,   64,  572,   64,  572,   64,  572,  414 },
-                                               { 1656, 2288,  256, 2288,  256, 2288,  256, 2288, 1656 } },
-                                             { {  409,  593,    0,  593,    0,  593,    0,  593,  409 },
-                                               { 1638, 2375,    0, 2375,    0, 2375,    0, 2375, 1638 } } };
-
-        const uint16_t hdr_p3_gray[3][2][15] = { { {  721,    4,   64,  152,  239,  327,  414,  502,  590,  677,  765,  852,  940, 1019,  721 },
-                                                   { 2884,   16,  256,  608,  956, 1308, 1656, 2008, 2360, 2708, 3060, 3408, 3760, 4076, 2884 } },
-                                                 { {  572,    4,   64,  152,  239,  327,  414,  502,  590,  677,  765,  852,  940, 1019,  572 },
-                                                   { 2288,   16,  256,  608,  956, 1308, 1656, 2008, 2360, 2708, 3060, 3408, 3760, 4076, 2288 } },
-                                                 { {  593,    0,    0,  102,  205,  307,  409,  512,  614,  716,  818,  921, 1023, 1023,  593 },
-                                                   { 2375,    0,    0,  410,  819, 1229, 1638, 2048, 2457, 2867, 3276, 3686, 4095, 4095, 2375 } } };
-
-        const uint16_t hdr_p4_gray[3][2][3] = { { {  64,   4, 1019 },
-                                                  { 256,  16, 4079 } },
-                                                { {  64,   4, 1019 },
-                                                  { 256,  16, 4079 } },
-                                                { {   0,   0, 1023 },
-                                                  {   0,   0, 4095 } } };
-
-        const uint16_t hdr_p5_r[3][2][15] = { { {  713,  538,  512,   64,   48,   64,   80,   64,   99,   64,  721,   64,  651,  639,  227 },
-                                                { 2852, 2152, 2048,  256,  192,  256,  320,  256,  396,  256, 2884,  256, 2604, 2556,  908 } },
-                                              { {  568,  484,  474,   64,   48,   64,   80,   64,   99,   64,  572,   64,  536,  530,  317 },
-                                                { 2272, 1936, 1896,  256,  192,  256,  320,  256,  396,  256, 2288,  256, 2144, 2120, 1268 } },
-                                              { {  589,  491,  478,    0,    0,    0,   20,    0,   41,    0,  593,    0,  551,  544,  296 },
-                                                { 2356, 1964, 1915,    0,    0,    0,   82,    0,  164,    0, 2375,    0, 2206, 2178, 1184 } } };
-        const uint16_t hdr_p5_g[3][2][15] = { { {  719,  709,  706,   64,   48,   64,   80,   64,   99,   64,  721,   64,  286,  269,  147 },
-                                                { 2876, 2836, 2824,  256,  192,  256,  320,  256,  396,  256, 2884,  256, 1144, 1076,  588 } },
-                                              { {  571,  566,  564,   64,   48,   64,   80,   64,   99,   64,  572,   64,  361,  350,  236 },
-                                                { 2284, 2264, 2256,  256,  192,  256,  320,  256,  396,  256, 2288,  256, 1444, 1400,  944 } },
-                                              { {  592,  586,  584,    0,    0,    0,   20,    0,   41,    0,  593,    0,  347,  334,  201 },
-                                                { 2370, 2345, 2339,    0,    0,    0,   82,    0,  164,    0, 2375,    0, 1389, 1337,  805 } } };
-        const uint16_t hdr_p5_b[3][2][15] = { { {  316,  718,  296,   64,   48,   64,   80,   64,   99,   64,  721,   64,  705,  164,  702 },
-                                                { 1264, 2872, 1184,  256,  192,  256,  320,  256,  396,  256, 2884,  256, 2820,  656, 2808 } },
-                                              { {  381,  571,  368,   64,   48,   64,   80,   64,   99,   64,  572,   64,  564,  256,  562 },
-                                                { 1524, 2284, 1472,  256,  192,  256,  320,  256,  396,  256, 2288,  256, 2256, 1024, 2248 } },
-                                              { {  370,  592,  355,    0,    0,    0,   20,    0,   41,    0,  593,    0,  584,  225,  582 },
-                                                { 1480, 2368, 1420,    0,    0,    0,   82,    0,  164,    0, 2375,    0, 2336,  900, 2328 } } };
-
-        // [resolution][compatability][bar width]
-        const int p1_widths[10][3][10] = { { {   4, 101, 102, 102, 102, 102, 102, 101,   4 }, // 525-line (NTSC BT.601)
-                                             {   4, 102, 102, 102, 100, 102, 102, 102,   4 },
-                                             {   0, 104, 102, 102, 102, 104, 102, 104,   0 } },
-                                           { {   9,  87,  88,  88,  88,  88,  88,  88,  87,   9 }, // 625-line (PAL BT.601)
-                                             {   8,  88,  88,  88,  88,  88,  88,  88,  88,   8 },
-                                             {   0,  90,  90,  90,  90,  90,  90,  90,  90,   0 } },
-                                           { { 160, 137, 137, 137, 138, 137, 137, 137, 160 }, // 720
-                                             { 160, 138, 136, 138, 136, 138, 136, 138, 160 },
-                                             { 156, 142, 136, 138, 136, 138, 136, 142, 156 } },
-                                           { { 240, 205, 206, 206, 206, 206, 206, 205, 240 }, // 1080
-                                             { 240, 206, 206, 206, 204, 206, 206, 206, 240 },
-                                             { 236, 210, 206, 206, 204, 206, 206, 210, 236 } },
-                                           { { 304, 205, 206, 206, 206, 206, 206, 205, 304 }, // 2K
-                                             { 304, 206, 206, 206, 204, 206, 206, 206, 304 },
-                                             { 300, 210, 206, 206, 204, 206, 206, 210, 300 } },
-                                           { { 480, 410, 412, 412, 412, 412, 412, 410, 480 }, // UHD
-                                             { 480, 412, 412, 412, 410, 412, 412, 412, 480 },
-                                             { 472, 420, 412, 412, 408, 412, 412, 420, 472 } },
-                                           { { 608, 410, 412, 412, 412, 412, 412, 410, 608 }, // 4K
-                                             { 608, 412, 412, 412, 410, 412, 412, 412, 608 },
-                                             { 600, 420, 412, 412, 408, 412, 412, 420, 600 } },
-                                           { { 960, 820, 824, 824, 824, 824, 824, 820, 960 }, // 8K
-                                             { 960, 824, 824, 824, 816, 824, 824, 824, 960 },
-                                             { 944, 840, 824, 824, 816, 824, 824, 840, 944 } },
-                                           { {   5, 109, 108, 108, 108, 108, 108, 109,   5 }, // 525-line (NTSC 4fsc)
-                                             {   4, 110, 108, 108, 108, 108, 108, 110,   4 },
-                                             {   0, 108, 110, 110, 112, 110, 110, 108,   0 } },
-                                           { {  12, 117, 115, 115, 115, 115, 115, 115, 117, 12 }, // 625-line (PAL 4fsc)
-                                             {  12, 116, 116, 116, 114, 114, 116, 116, 116, 12 },
-                                             {   0, 120, 118, 118, 118, 118, 118, 118, 120,  0 } } };
-
-        // [resolution][compatability][bar width]
-        const int p4_widths[10][3][11] = { { {   4, 127, 128, 127, 128,  34,  34,  34, 101,   4,   0 }, // 525-line (NTSC BT.601)
-                                             {   4, 126, 128, 126, 128,  34,  34,  34, 102,   4,   0 },
-                                             {   0, 128, 130, 128, 128,  34,  34,  34, 104,   0,   0 } },
-                                           { {   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 }, // 625-line (PAL BT.601)
-                                             {   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 },
-                                             {   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 } },
-                                           { { 160, 206, 274, 115,  46,  45,  46,  46,  45, 137, 160 }, // 720
-                                             { 160, 206, 274, 116,  46,  44,  46,  46,  44, 138, 160 },
-                                             { 156, 210, 274, 116,  46,  44,  46,  46,  44, 142, 156 } },
-                                           { { 240, 309, 411, 171,  69,  68,  69,  68,  69, 206, 240 }, // 1080
-                                             { 240, 308, 412, 170,  68,  70,  68,  70,  68, 206, 240 },
-                                             { 236, 312, 412, 170,  68,  70,  68,  70,  68, 210, 236 } },
-                                           { { 304, 309, 411, 171,  69,  68,  69,  68,  69, 206, 304 }, // 2K
-                                             { 304, 308, 412, 170,  68,  70,  68,  70,  68, 206, 304 },
-                                             { 300, 312, 412, 170,  68,  70,  68,  70,  68, 210, 300 } },
-                                           { { 480, 618, 822, 342, 138, 136, 138, 136, 138, 412, 480 }, // UHD
-                                             { 480, 616, 824, 340, 136, 140, 136, 140, 136, 412, 480 },
-                                             { 472, 624, 824, 340, 136, 140, 136, 140, 136, 420, 472 } },
-                                           { { 608, 618, 822, 342, 138, 136, 138, 136, 138, 412, 608 }, // 4K
-                                             { 608, 616, 824, 340, 136, 140, 136, 140, 136, 412, 608 },
-                                             { 600, 624, 824, 340, 136, 140, 136, 140, 136, 420, 600 } },
-                                           { { 960, 1236,1644,684, 276, 272, 276, 272, 276, 824, 960 }, // 8K
-                                             { 960, 1232,1648,680, 272, 280, 272, 280, 272, 824, 960 },
-                                             { 944, 1248,1648,680, 272, 280, 272, 280, 272, 840, 944 } },
-                                           { {   5, 136, 135, 135, 135,  36,  36,  36, 109,   5,   0 }, // 525-line (NTSC 4fsc)
-                                             {   4, 136, 136, 136, 136,  36,  36,  36, 110,   4,   0 },
-                                             {   0, 138, 138, 138, 136,  36,  38,  36, 108,   0,   0 } },
-                                           { {   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 }, // 625-line (PAL 4fsc)
-                                             {   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 },
-                                             {   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 } } };
-
-        // [resolution][bar width]
-        const int hdr_p1_widths[5][9] = { { 240, 206, 206, 206, 204, 206, 206, 206, 240 },   // 1080
-                                          { 304, 206, 206, 206, 204, 206, 206, 206, 304 },   // 2K
-                                          { 480, 412, 412, 412, 408, 412, 412, 412, 480 },   // UHD
-                                          { 608, 412, 412, 412, 408, 412, 412, 412, 608 },   // 4K
-                                          { 960, 824, 824, 824, 816, 824, 824, 824, 960 } }; // 8K
-
-        const int hdr_p3_widths[5][15] = { { 240, 206, 103, 103, 103, 103, 102, 102, 103, 103, 103, 103, 103, 103, 240 },   // 1080
-                                           { 304, 206, 103, 103, 103, 103, 102, 102, 103, 103, 103, 103, 103, 103, 304 },   // 2K
-                                           { 480, 412, 206, 206, 206, 206, 204, 204, 206, 206, 206, 206, 206, 206, 480 },   // UHD
-                                           { 608, 412, 206, 206, 206, 206, 204, 204, 206, 206, 206, 206, 206, 206, 608 },   // 4K
-                                           { 960, 824, 412, 412, 412, 412, 408, 408, 412, 412, 412, 412, 412, 412, 960 } }; // 8K
-
-        // [depth][hdr system][resolution][bar width]
-        const int hdr_p4_widths[2][3][5][4] = { { { {  240,  559, 1014,  107 }, // HLG 10-bit
-                                                    {  304,  559, 1014,  171 },
-                                                    {  480, 1118, 2028,  214 },
-                                                    {  608, 1118, 2028,  342 },
-                                                    {  960, 2236, 4056,  428 } } ,
-                                                  { {  240,  559, 1014,  107 }, // PQ 10-bit
-                                                    {  304,  559, 1014,  171 },
-                                                    {  480, 1118, 2028,  214 },
-                                                    {  608, 1118, 2028,  342 },
-                                                    {  960, 2236, 4056,  428 } } ,
-                                                  { {  240,  551, 1022,  107 }, // PQ full range 10-bit
-                                                    {  304,  551, 1022,  171 },
-                                                    {  480, 1102, 2044,  214 },
-                                                    {  608, 1102, 2044,  342 },
-                                                    {  960, 2204, 4088,  428 } } } ,
-                                                { { {  240,  559, 1015,  106 }, // HLG 12-bit
-                                                    {  304,  559, 1015,  170 },
-                                                    {  480, 1117, 2031,  212 },
-                                                    {  608, 1117, 2031,  340 },
-                                                    {  960, 2233, 4062,  425 } } ,
-                                                  { {  240,  559, 1015,  106 }, // PQ 12-bit
-                                                    {  304,  559, 1015,  170 },
-                                                    {  480, 1117, 2031,  212 },
-                                                    {  608, 1117, 2031,  340 },
-                                                    {  960, 2233, 4062,  425 } } ,
-                                                  { {  240,  551, 1023,  106 }, // PQ full range 12-bit
-                                                    {  304,  551, 1023,  170 },
-                                                    {  480, 1101, 2047,  212 },
-                                                    {  608, 1101, 2047,  340 },
-                                                    {  960, 2201, 4094,  425 } } } };
-
-        const int hdr_p5_widths[5][15] = { {  80,   80,   80,  136,   70,   68,   70,   68,   70,  238,  438,  282,   80,   80,   80 },   // 1080
-                                           { 144,   80,   80,  136,   70,   68,   70,   68,   70,  238,  438,  282,   80,   80,  144 },   // 2K
-                                           { 160,  160,  160,  272,  140,  136,  140,  136,  140,  476,  876,  564,  160,  160,  160 },   // UHD
-                                           { 288,  160,  160,  272,  140,  136,  140,  136,  140,  476,  876,  564,  160,  160,  288 },   // 4K
-                                           { 320,  320,  320,  544,  280,  272,  280,  272,  280,  952, 1752, 1128,  320,  320,  320 } }; // 8K
-
-        const int compat = d->compatability;
-        const int resolution = d->resolution;
-        const int hdr = d->hdr;
-        const int wcg = d->wcg;
-        const int depth = d->vi.format.bitsPerSample == 10 ? 0 : 1;
-        const int iq = d->iq;
-        const int height = d->vi.height;
-        const int width = d->vi.width;
-
-        VSFrame *frame = 0;
-        frame = vsapi->newVideoFrame(&d->vi.format, width, height, 0, core);
-        VSMap *props = vsapi->getFramePropertiesRW(frame);
+        memcpy(g->p1, hdr_p1_widths[resolution - 3], sizeof(g->p1));
+        memcpy(g->hdr_p3, hdr_p3_widths[resolution - 3], sizeof(g->hdr_p3));
+        memcpy(g->hdr_p4, hdr_p4_widths[depth][hdr - 1][resolution - 3], sizeof(g->hdr_p4));
+        memcpy(g->hdr_p5, hdr_p5_widths[resolution - 3], sizeof(g->hdr_p5));
+        const int rows[5] = { height / 12, height / 2, height / 12, height / 12, height / 4 };
+        memcpy(g->rows, rows, sizeof(rows));
+    }
+    else
+    {
+        memcpy(g->p1, p1_widths[resolution][compat], sizeof(g->p1));
+        memcpy(g->p4, p4_widths[resolution][compat], sizeof(g->p4));
+        for (int i = 0; i < 6; i++)
+            g->rows[i] = i ? height / 12 : height / 12 * 7;
+    }
+}
+
+// Rounds x to the nearest multiple of unit inside [lo, hi]
+static int align_edge(double x, int unit, int lo, int hi)
+{
+    int e = (int)(x / unit + 0.5) * unit;
+    return e < lo ? lo : e > hi ? hi : e;
+}
+
+// Turns the n - 1 edges between n bars into widths.  Edges are in the 1080 reference, where the
+// 4:3 area runs from 0 to 1440, and margin moves the outermost ones out for 4:3 center-cut.
+static void scale_widths(int *widths, const double *edges, int n, const ColorBarsData *d, int unit, int margin)
+{
+    const int width = d->vi.width;
+    double area = d->vi.height * 4.0 / 3.0;
+    if (area > width)
+        area = width;
+    const double left = (width - area) / 2.0;
+    int x = 0;
+    for (int i = 0; i < n - 1; i++)
+    {
+        const double m = i == 0 ? -margin : i == n - 2 ? margin : 0;
+        const int e = align_edge(left + edges[i] * area / 1440.0 + m, unit, x, width);
+        widths[i] = e - x;
+        x = e;
+    }
+    widths[n - 1] = width - x;
+}
+
+// Band heights from the edges between them, in twelfths of the picture height
+static void scale_rows(int *rows, const int *twelfths, int n, int height, int unit)
+{
+    int y = 0;
+    for (int i = 0; i < n - 1; i++)
+    {
+        const int e = align_edge(height * twelfths[i] / 12.0, unit, y, height);
+        rows[i] = e - y;
+        y = e;
+    }
+    rows[n - 1] = height - y;
+}
+
+// The RP 219 and BT.2111 layouts scaled to any raster.  The bars are fractions of the 4:3 area,
+// which is centered and 4/3 of the height wide, and the side panels take the rest.  The edges
+// follow the compatability rules: rounded, on even samples, or on even samples in each 2SI
+// sub-image with the outer bars past the 4:3 edges.  HDR has no such modes and is rounded.
+static void scaled_geometry(const ColorBarsData *d, BarGeometry *g)
+{
+    const double c = 1440.0 / 7.0;
+    const int interlaced = d->scan != SCAN_PROGRESSIVE;
+    double p1[8];
+    for (int i = 0; i < 8; i++)
+        p1[i] = i * c;
+
+    if (d->hdr)
+    {
+        const int depth = d->vi.format.bitsPerSample <= 10 ? 0 : 1;
+        const int *p4 = hdr_p4_widths[depth][d->hdr - 1][0];
+        const int *p5 = hdr_p5_widths[0];
+        double p3[14] = { 0, c };
+        for (int i = 2; i < 14; i++)
+            p3[i] = c + (i - 1) * c / 2.0;
+        const double p4_edges[3] = { p4[0] - 240, p4[0] + p4[1] - 240, p4[0] + p4[1] + p4[2] - 240 };
+        double p5_edges[14];
+        for (int i = 0, x = -240; i < 14; i++)
+            p5_edges[i] = x += p5[i];
+        scale_widths(g->p1, p1, 9, d, 1, 0);
+        scale_widths(g->hdr_p3, p3, 15, d, 1, 0);
+        scale_widths(g->hdr_p4, p4_edges, 4, d, 1, 0);
+        scale_widths(g->hdr_p5, p5_edges, 15, d, 1, 0);
+        const int rows[4] = { 1, 7, 8, 9 };
+        scale_rows(g->rows, rows, 5, d->vi.height, 1 << interlaced);
+    }
+    else
+    {
+        int unit = d->compatability ? 2 : 1;
+        if (d->compatability == 2)
+            for (int w = d->vi.width; w >= 3840 && unit < 8; w /= 2)
+                unit *= 2;
+        const int margin = d->compatability == 2 ? 2 * unit : 0;
+        // black 3/2, white 2, black 5/6, five PLUGE chips of 1/3 and a black bar
+        const double p4[10] = { 0, 1.5 * c, 3.5 * c, 13.0 / 3.0 * c, 14.0 / 3.0 * c, 5 * c, 16.0 / 3.0 * c,
+                                17.0 / 3.0 * c, 6 * c, 7 * c };
+        scale_widths(g->p1, p1, 9, d, unit, margin);
+        scale_widths(g->p4, p4, 11, d, unit, margin);
+        const int rows[5] = { 7, 8, 9, 10, 11 };
+        scale_rows(g->rows, rows, 6, d->vi.height, (d->compatability ? 2 : 1) << interlaced);
+    }
+}
+
+// Layout construction.  Bands are added top to bottom and spans left to right;
+// the cursor tracks where the next one goes.
+typedef struct {
+    ColorBarsPlane *planes;
+    int x;
+    int y;
+} LayoutBuilder;
+
+static void layout_band(LayoutBuilder *b, int height)
+{
+    for (int p = 0; p < 3; p++)
+    {
+        ColorBarsPlane *plane = &b->planes[p];
+        plane->bands = (ColorBarsBand *)realloc(plane->bands, (plane->num_bands + 1) * sizeof(ColorBarsBand));
+        ColorBarsBand band = { b->y, height, plane->num_spans, 0 };
+        plane->bands[plane->num_bands++] = band;
+    }
+    b->x = 0;
+    b->y += height;
+}
+
+static void plane_span(ColorBarsPlane *plane, int x, int width, float base, float slope)
+{
+    if (width <= 0)
+        return;
+    plane->spans = (ColorBarsSpan *)realloc(plane->spans, (plane->num_spans + 1) * sizeof(ColorBarsSpan));
+    ColorBarsSpan span = { x, width, base, slope };
+    plane->spans[plane->num_spans++] = span;
+    plane->bands[plane->num_bands - 1].num_spans++;
+}
+
+// one sample run per plane, each either flat or a ramp
+static void layout_span(LayoutBuilder *b, int width, const float base[3], const float slope[3])
+{
+    for (int p = 0; p < 3; p++)
+        plane_span(&b->planes[p], b->x, width, base[p], slope[p]);
+    b->x += width;
+}
+
+static void layout_bar(LayoutBuilder *b, int width, int y, int u, int v)
+{
+    const float base[3] = { y, u, v };
+    const float slope[3] = { 0 };
+    layout_span(b, width, base, slope);
+}
+
+// luma ramp over flat chroma
+static void layout_ramp(LayoutBuilder *b, int width, int y, float slope, int u, int v)
+{
+    const float base[3] = { y, u, v };
+    const float slopes[3] = { slope, 0, 0 };
+    layout_span(b, width, base, slopes);
+}
 
-        if (hdr)
+// a pattern from a layout file
+static void layout_file(LayoutBuilder *b, const ColorBarsLayoutFile *file)
+{
+    for (int i = 0; i < file->num_patches; i++)
+    {
+        const ColorBarsPatch *patch = &file->patches[i];
+        if (patch->height)
+            layout_band(b, patch->height);
+        // ramps end on the last values; ramps are truncated, so the slope is nudged until the last
+        // sample doesn't fall short of them
+        float slope[3] = { 0 };
+        for (int p = 0; p < 3 && patch->width > 1; p++)
         {
-            vsapi->mapSetInt(props, "_Matrix", VSC_MATRIX_RGB, maReplace);
-            vsapi->mapSetInt(props, "_Transfer", hdr == 1 ? VSC_TRANSFER_ARIB_B67 : VSC_TRANSFER_ST2084, maReplace);
-            vsapi->mapSetInt(props, "_Primaries", VSC_PRIMARIES_BT2020, maReplace);
-            vsapi->mapSetInt(props, "_SARNum", 1, maReplace);
-            vsapi->mapSetInt(props, "_SARDen", 1, maReplace);
+            slope[p] = (patch->end[p] - patch->value[p]) / (patch->width - 1);
+            for (int k = 0; k < 4 && patch->value[p] + (patch->width - 1) * slope[p] < patch->end[p]; k++)
+                slope[p] = nextafterf(slope[p], INFINITY);
         }
-        else
+        layout_span(b, patch->width, patch->value, slope);
+    }
+}
+
+// Splits row off its band and overwrites [x0, x1) on it.  Used for half line blanking.
+static void layout_blank(LayoutBuilder *b, int row, int x0, int x1, int y, int c)
+{
+    const int blank[3] = { y, c, c };
+    for (int p = 0; p < 3; p++)
+    {
+        ColorBarsPlane *plane = &b->planes[p];
+        int i = 0;
+        while (row < plane->bands[i].y || row >= plane->bands[i].y + plane->bands[i].height)
+            i++;
+        ColorBarsBand band = plane->bands[i];
+
+        // whatever is left above and below the row keeps the old spans
+        int above = row - band.y;
+        int below = band.y + band.height - row - 1;
+        plane->bands[i].height = above;
+        if (below)
         {
-            if (resolution < HD720 || resolution > UHDTV2)
+            plane->bands = (ColorBarsBand *)realloc(plane->bands, (plane->num_bands + 1) * sizeof(ColorBarsBand));
+            ColorBarsBand rest = { row + 1, below, band.span, band.num_spans };
+            plane->bands[plane->num_bands++] = rest;
+        }
+
+        plane->bands = (ColorBarsBand *)realloc(plane->bands, (plane->num_bands + 1) * sizeof(ColorBarsBand));
+        ColorBarsBand line = { row, 1, plane->num_spans, 0 };
+        plane->bands[plane->num_bands++] = line;
+        for (int s = band.span; s < band.span + band.num_spans; s++)
+        {
+            ColorBarsSpan span = plane->spans[s];
+            int end = span.x + span.width;
+            plane_span(plane, span.x, (end < x0 ? end : x0) - span.x, span.base, span.slope);
+            if (end > x1)
             {
-                if (resolution == PAL || resolution == PAL_4FSC)
-                {
-                    vsapi->mapSetInt(props, "_Matrix", VSC_MATRIX_BT470_BG, maReplace);
-                    vsapi->mapSetInt(props, "_Primaries", VSC_PRIMARIES_BT470_BG, maReplace);
-                    vsapi->mapSetInt(props, "_SARNum", resolution == PAL ? 128 : 547, maReplace);
-                    vsapi->mapSetInt(props, "_SARDen", resolution == PAL ? 117 : 657, maReplace);
-                }
-                else
-                {
-                    vsapi->mapSetInt(props, "_Matrix", VSC_MATRIX_ST170_M, maReplace);
-                    vsapi->mapSetInt(props, "_Primaries", VSC_PRIMARIES_ST170_M, maReplace);
-                    vsapi->mapSetInt(props, "_SARNum", resolution == NTSC ? 4320 : 352, maReplace);
-                    vsapi->mapSetInt(props, "_SARDen", resolution == NTSC ? 4739 : 413, maReplace);
-                }
-                vsapi->mapSetInt(props, "_Transfer", VSC_TRANSFER_BT601, maReplace);
+                int start = span.x > x1 ? span.x : x1;
+                plane_span(plane, start, end - start, span.base + (start - span.x) * span.slope, span.slope);
             }
+        }
+        plane_span(plane, x0, x1 - x0, blank[p], 0);
+    }
+}
+
+// Maps a full resolution plane onto a subsampled chroma grid.  Chroma sample i is co-sited
+// with luma sample i << ssw, so it takes the value of whichever span covers that position.
+// Rows are treated the same way for 4:2:0, and with a phase of 1 for the bottom field.
+static void subsample_plane(ColorBarsPlane *plane, int ssw, int ssh, int phase)
+{
+    for (int i = 0; i < plane->num_bands; i++)
+    {
+        ColorBarsBand *band = &plane->bands[i];
+        int y0 = (band->y - phase + (1 << ssh) - 1) >> ssh;
+        int y1 = (band->y + band->height - phase + (1 << ssh) - 1) >> ssh;
+        band->y = y0;
+        band->height = y1 - y0;
+    }
+    for (int i = 0; i < plane->num_spans; i++)
+    {
+        ColorBarsSpan *span = &plane->spans[i];
+        int x0 = (span->x + (1 << ssw) - 1) >> ssw;
+        int x1 = (span->x + span->width + (1 << ssw) - 1) >> ssw;
+        span->base += ((x0 << ssw) - span->x) * span->slope;
+        span->slope *= 1 << ssw;
+        span->x = x0;
+        span->width = x1 - x0;
+    }
+}
+
+// Moves a plane built from the 10 or 12-bit tables to the output format.  Other integer depths
+// are scaled from the nearest table and rounded, float is normalized to 0-1 (or -0.5-0.5 for chroma).
+static void convert_plane(ColorBarsPlane *plane, const VSVideoFormat *f, int table_bits, int chroma, int full)
+{
+    float offset = 0.0f;
+    float scale = 1.0f;
+    float round = 0.0f;
+    if (f->sampleType == stFloat)
+    {
+        if (full)
+            scale = 1.0f / ((1 << table_bits) - 1);
+        else
+        {
+            offset = (chroma ? 128 : 16) << (table_bits - 8);
+            scale = 1.0f / ((chroma ? 224 : 219) << (table_bits - 8));
+        }
+    }
+    else if (f->bitsPerSample != table_bits)
+    {
+        scale = (float)(1 << f->bitsPerSample) / (1 << table_bits);
+        round = scale < 1.0f ? 0.5f : 0.0f;
+    }
+
+    // 0 and the top code (and 1-3 and the last 4 at 10 bits) are reserved in narrow range
+    if (f->sampleType == stInteger)
+    {
+        const int reserved = full ? 0 : 1 << (f->bitsPerSample - 8);
+        plane->lo = reserved;
+        plane->hi = (1 << f->bitsPerSample) - 1 - reserved;
+    }
+    if (offset == 0.0f && scale == 1.0f)
+        return;
+
+    for (int i = 0; i < plane->num_spans; i++)
+    {
+        ColorBarsSpan *span = &plane->spans[i];
+        span->base = (span->base - offset) * scale + round;
+        span->slope *= scale;
+        if (f->sampleType == stInteger && span->slope == 0.0f)
+        {
+            int v = (int)span->base;
+            span->base = v < plane->lo ? plane->lo : v > plane->hi ? plane->hi : v;
+        }
+    }
+}
+
+// A few rows of the width tables add up to a sample or two past the raster, the last bar loses them
+static void clip_plane(ColorBarsPlane *plane, int width)
+{
+    for (int i = 0; i < plane->num_spans; i++)
+        if (plane->spans[i].x + plane->spans[i].width > width)
+            plane->spans[i].width = width - plane->spans[i].x;
+}
+
+static void clone_plane(ColorBarsPlane *dst, const ColorBarsPlane *src)
+{
+    *dst = *src;
+    dst->bands = (ColorBarsBand *)malloc(src->num_bands * sizeof(ColorBarsBand));
+    dst->spans = (ColorBarsSpan *)malloc(src->num_spans * sizeof(ColorBarsSpan));
+    memcpy(dst->bands, src->bands, src->num_bands * sizeof(ColorBarsBand));
+    memcpy(dst->spans, src->spans, src->num_spans * sizeof(ColorBarsSpan));
+}
+
+void colorbars_free_layout(ColorBarsData *d)
+{
+    for (int f = 0; f < 2; f++)
+    {
+        for (int p = 0; p < 3; p++)
+        {
+            free(d->planes[f][p].bands);
+            free(d->planes[f][p].spans);
+        }
+    }
+    free(d->zone);
+    if (d->layout)
+        colorbars_layout_free(d->layout);
+    free(d->layout);
+}
+
+// Resolves every parameter into band and span lists, so rendering is a straight walk over them.
+static void compile_layout(ColorBarsData *d)
+{
+    const int compat = d->compatability;
+    const int resolution = d->resolution;
+    const int hdr = d->hdr;
+    const int wcg = d->wcg;
+    const int depth = d->vi.format.bitsPerSample <= 10 ? 0 : 1;
+    const int iq = d->iq;
+    const int height = d->vi.height;
+    const int width = d->vi.width;
+
+    LayoutBuilder b = { d->planes[0], 0, 0 };
+    BarGeometry g = { 0 };
+    if (!d->layout && resolution >= HD720 && resolution <= UHDTV2)
+    {
+        if (d->scaled)
+            scaled_geometry(d, &g);
+        else
+            table_geometry(d, &g);
+    }
+
+    if (d->layout)
+        layout_file(&b, d->layout);
+    else if (resolution == NTSC || resolution == NTSC_4FSC)
+    {
+        // pattern 1
+        layout_band(&b, ntsc_heights[compat][0]);
+        for (int bar = 0; bar < 9; bar++)
+            layout_bar(&b, p1_widths[resolution][compat][bar], ntsc1_y[depth][bar], ntsc1_u[depth][bar], ntsc1_v[depth][bar]);
+        // pattern 2
+        layout_band(&b, ntsc_heights[compat][1]);
+        for (int bar = 0; bar < 9; bar++)
+            layout_bar(&b, p1_widths[resolution][compat][bar], ntsc2_y[depth][bar], ntsc2_u[depth][bar], ntsc2_v[depth][bar]);
+        // pattern 3
+        layout_band(&b, ntsc_heights[compat][2]);
+        for (int bar = 0; bar < 10; bar++)
+            layout_bar(&b, p4_widths[resolution][compat][bar], ntsc3_y[depth][bar], ntsc3_u[depth][bar], ntsc3_v[depth][bar]);
+        if (d->halfline)
+        {
+            int blank_y = 64 << (depth * 2);
+            int blank_c = 512 << (depth * 2);
+            // video starts 41.259 us after 0H
+            layout_blank(&b, 0, 0, resolution == NTSC_4FSC ? 461 : 413, blank_y, blank_c);
+            // video ends 30.592 us after 0H
+            layout_blank(&b, height - 1, resolution == NTSC_4FSC ? 309 : 291, width, blank_y, blank_c);
+        }
+    }
+    else if (resolution == PAL || resolution == PAL_4FSC)
+    {
+        layout_band(&b, height);
+        for (int bar = 0; bar < 10; bar++)
+            layout_bar(&b, p1_widths[resolution][compat][bar], pal_y[depth][bar], pal_u[depth][bar], pal_v[depth][bar]);
+        if (d->halfline)
+        {
+            int blank_y = 64 << (depth * 2);
+            int blank_c = 512 << (depth * 2);
+            // video starts 42.5 us after 0H
+            layout_blank(&b, 0, 0, resolution == PAL_4FSC ? 580 : 410, blank_y, blank_c);
+            // video ends 30.35 us after 0H
+            layout_blank(&b, height - 1, resolution == PAL_4FSC ? 365 : 278, width, blank_y, blank_c);
+        }
+    }
+    else if ( hdr ) // HDR systems
+    {
+        // pattern 1 - 100% top strip
+        layout_band(&b, g.rows[0]);
+        for (int bar = 0; bar < 9; bar++)
+            layout_bar(&b, g.p1[bar], hdr_p1_r[hdr - 1][depth][bar], hdr_p1_g[hdr - 1][depth][bar], hdr_p1_b[hdr - 1][depth][bar]);
+        // pattern 2 - 75%/58% bars
+        layout_band(&b, g.rows[1]);
+        for (int bar = 0; bar < 9; bar++)
+            layout_bar(&b, g.p1[bar], hdr_p2_r[hdr - 1][depth][bar], hdr_p2_g[hdr - 1][depth][bar], hdr_p2_b[hdr - 1][depth][bar]);
+        // pattern 3 - grayscale
+        layout_band(&b, g.rows[2]);
+        for (int bar = 0; bar < 15; bar++)
+            layout_bar(&b, g.hdr_p3[bar], hdr_p3_gray[hdr - 1][depth][bar], hdr_p3_gray[hdr - 1][depth][bar], hdr_p3_gray[hdr - 1][depth][bar]);
+        // pattern 4 - ramp
+        layout_band(&b, g.rows[3]);
+        for (int bar = 0; bar < 2; bar++)
+            layout_bar(&b, g.hdr_p4[bar], hdr_p4_gray[hdr - 1][depth][bar], hdr_p4_gray[hdr - 1][depth][bar], hdr_p4_gray[hdr - 1][depth][bar]);
+        uint16_t rampwidth = g.hdr_p4[2];
+        uint16_t rampheight = hdr_p4_gray[hdr - 1][depth][2] - hdr_p4_gray[hdr - 1][depth][1];
+        float slope = (float)rampheight / (float)rampwidth;
+        const float ramp_base[3] = { hdr_p4_gray[hdr - 1][depth][1], hdr_p4_gray[hdr - 1][depth][1], hdr_p4_gray[hdr - 1][depth][1] };
+        const float ramp_slope[3] = { slope, slope, slope };
+        layout_span(&b, rampwidth, ramp_base, ramp_slope);
+        layout_bar(&b, g.hdr_p4[3], hdr_p4_gray[hdr - 1][depth][2], hdr_p4_gray[hdr - 1][depth][2], hdr_p4_gray[hdr - 1][depth][2]);
+        // pattern 5 - 75%/58% 709 bars
+        layout_band(&b, g.rows[4]);
+        for (int bar = 0; bar < 15; bar++)
+            layout_bar(&b, g.hdr_p5[bar], hdr_p5_r[hdr - 1][depth][bar], hdr_p5_g[hdr - 1][depth][bar], hdr_p5_b[hdr - 1][depth][bar]);
+    }
+    else // HD and higher SDR systems
+    {
+        // pattern 1
+        layout_band(&b, g.rows[0]);
+        for (int bar = 0; bar < 9; bar++)
+            layout_bar(&b, g.p1[bar], p1_y[wcg][depth][bar], p1_u[wcg][depth][bar], p1_v[wcg][depth][bar]);
+        // pattern 2
+        layout_band(&b, g.rows[1]);
+        layout_bar(&b, g.p1[0], p2_y[wcg][depth][0], p2_u[wcg][depth][0], p2_v[wcg][depth][0]);
+        // sub-pattern *2: 100% white, -I, +I, or 75% white
+        int iqbar = iq ? iq + 8 : 1;
+        layout_bar(&b, g.p1[1], p2_y[wcg][depth][iqbar], p2_u[wcg][depth][iqbar], p2_v[wcg][depth][iqbar]);
+        for (int bar = 2; bar < 9; bar++)
+            layout_bar(&b, g.p1[bar], p2_y[wcg][depth][bar], p2_u[wcg][depth][bar], p2_v[wcg][depth][bar]);
+        // pattern 3
+        layout_band(&b, g.rows[2]);
+        layout_bar(&b, g.p1[0], p3_y[wcg][depth][0], p3_u[wcg][depth][0], p3_v[wcg][depth][0]);
+        // sub-pattern *3: 0% black or +Q
+        iqbar = iq == IQ_BOTH ? iq + 8 : 1;
+        layout_bar(&b, g.p1[1], p3_y[wcg][depth][iqbar], p3_u[wcg][depth][iqbar], p3_v[wcg][depth][iqbar]);
+        // Y ramp
+        uint16_t rampwidth = g.p1[2] + g.p1[3] +
+            g.p1[4] + g.p1[5] +
+            g.p1[6];
+        uint16_t rampheight = p3_y[wcg][depth][6] - p3_y[wcg][depth][2];
+        float slope = (float)rampheight / (float)rampwidth;
+        layout_ramp(&b, rampwidth, p3_y[wcg][depth][2], slope, p3_u[wcg][depth][2], p3_v[wcg][depth][2]);
+        for (int bar = 7; bar < 9; bar++)
+            layout_bar(&b, g.p1[bar], p3_y[wcg][depth][bar], p3_u[wcg][depth][bar], p3_v[wcg][depth][bar]);
+        // pattern 4a
+        layout_band(&b, g.rows[3]);
+        for (int bar = 0; bar < 11; bar++)
+            layout_bar(&b, g.p4[bar], p4_y[depth][bar], p4_u[depth][bar], p4_v[depth][bar]);
+        // pattern 4b
+        layout_band(&b, g.rows[4]);
+        layout_bar(&b, g.p4[0], p4_y[depth][0], p4_u[depth][0], p4_v[depth][0]);
+        // sub black
+        const int subblack = d->subblack;
+        rampwidth = g.p4[1] / 2;
+        rampheight = p4_y[depth][1] - p4_y[depth][11];
+        slope = (float)subblack * (float)rampheight / (float)rampwidth;
+        layout_ramp(&b, rampwidth, p4_y[depth][1], -slope, p4_u[depth][1], p4_v[depth][1]);
+        // the second half takes the odd sample, so the chips after it stay in line with 4a and 4c
+        layout_ramp(&b, g.p4[1] - rampwidth, p4_y[depth][1 + subblack * 10], slope, p4_u[depth][1], p4_v[depth][1]);
+        // super-white
+        const int superwhite = d->superwhite;
+        rampwidth = g.p4[2] / 2;
+        rampheight = p4_y[depth][12] - p4_y[depth][2];
+        slope = (float)superwhite * (float)rampheight / (float)rampwidth;
+        layout_ramp(&b, rampwidth, p4_y[depth][2], slope, p4_u[depth][2], p4_v[depth][2]);
+        layout_ramp(&b, g.p4[2] - rampwidth, p4_y[depth][2 + superwhite * 10], -slope, p4_u[depth][2], p4_v[depth][2]);
+        for (int bar = 3; bar < 11; bar++)
+            layout_bar(&b, g.p4[bar], p4_y[depth][bar], p4_u[depth][bar], p4_v[depth][bar]);
+        // pattern 4c
+        layout_band(&b, g.rows[5]);
+        for (int bar = 0; bar < 11; bar++)
+            layout_bar(&b, g.p4[bar], p4_y[depth][bar], p4_u[depth][bar], p4_v[depth][bar]);
+    }
+
+    for (int p = 0; p < 3; p++)
+    {
+        clip_plane(&d->planes[0][p], width);
+        // a 2SI sub-image takes every other line, like a field
+        if (d->division == DIVISION_2SI)
+            subsample_plane(&d->planes[0][p], 0, 1, d->subimage >> 1);
+    }
+
+    // each field takes every other row of the frame, half line blanking included
+    const int fields = d->scan == SCAN_FIELDS ? 2 : 1;
+    if (fields == 2)
+    {
+        for (int p = 0; p < 3; p++)
+        {
+            clone_plane(&d->planes[1][p], &d->planes[0][p]);
+            subsample_plane(&d->planes[0][p], 0, 1, 0);
+            subsample_plane(&d->planes[1][p], 0, 1, 1);
+        }
+    }
+
+    for (int f = 0; f < fields; f++)
+    {
+        if (d->vi.format.subSamplingW || d->vi.format.subSamplingH)
+            for (int p = 1; p < 3; p++)
+                subsample_plane(&d->planes[f][p], d->vi.format.subSamplingW, d->vi.format.subSamplingH, 0);
+
+        for (int p = 0; p < 3; p++)
+            convert_plane(&d->planes[f][p], &d->vi.format, d->layout ? d->layout->bits : depth ? 12 : 10, p && !hdr, hdr == 3);
+    }
+}
+
+// Integrated sine-squared edge shaping.  The taps are a sin^2 pulse, cos^2(pi * k / 8.3),
+// scaled to sum to 4096, which gives the 4 sample (10% to 90%) rise time of RP 219.
+#define SHAPE_RADIUS 4
+#define SHAPE_SHIFT 12
+
+typedef struct {
+    int radius;
+    int taps[2 * SHAPE_RADIUS + 1];
+} ShapeKernel;
+
+static const ShapeKernel shape_full = { 4, { 3, 176, 522, 853, 988, 853, 522, 176, 3 } };
+// subsampled chroma: the same rise time is 2 samples, which leaves a [1 2 1] pulse
+static const ShapeKernel shape_half = { 1, { 1024, 2048, 1024 } };
+
+// Filters the samples around the transition at x.  src is the unfiltered row.
+static void shape_edge(uint8_t *dst, const uint8_t *src, int width, int x, const ShapeKernel *shape, const VSVideoFormat *f)
+{
+    const int r = shape->radius;
+    int start = x - r > 0 ? x - r : 0;
+    int end = x + r < width ? x + r : width;
+    for (int i = start; i < end; i++)
+    {
+        int isum = 1 << (SHAPE_SHIFT - 1);
+        float fsum = 0.0f;
+        for (int k = -r; k <= r; k++)
+        {
+            int j = i + k < 0 ? 0 : i + k >= width ? width - 1 : i + k;
+            if (f->sampleType == stFloat)
+                fsum += shape->taps[k + r] * ((const float *)src)[j];
             else
-            {
-                vsapi->mapSetInt(props, "_Matrix",    wcg ? VSC_MATRIX_BT2020_NCL : VSC_MATRIX_BT709, maReplace);
-                vsapi->mapSetInt(props, "_Transfer", !wcg ? VSC_TRANSFER_BT709 :
-                                                    depth ? VSC_TRANSFER_BT2020_12 : VSC_TRANSFER_BT2020_10, maReplace);
-                vsapi->mapSetInt(props, "_Primaries", wcg ? VSC_PRIMARIES_BT2020 : VSC_PRIMARIES_BT709, maReplace);
-                vsapi->mapSetInt(props, "_SARNum", 1, maReplace);
-                vsapi->mapSetInt(props, "_SARDen", 1, maReplace);
-            }
+                isum += shape->taps[k + r] * (f->bytesPerSample == 1 ? src[j] : ((const uint16_t *)src)[j]);
         }
-        vsapi->mapSetInt(props, "_ColorRange", hdr == 3 ? 0 : 1, maReplace); // limited, unless full range PQ
+        if (f->sampleType == stFloat)
+            ((float *)dst)[i] = fsum * (1.0f / (1 << SHAPE_SHIFT));
+        else if (f->bytesPerSample == 1)
+            dst[i] = isum >> SHAPE_SHIFT;
+        else
+            ((uint16_t *)dst)[i] = isum >> SHAPE_SHIFT;
+    }
+}
 
-        uint16_t *y = (uint16_t *)vsapi->getWritePtr(frame, 0);
-        uint16_t *u = (uint16_t *)vsapi->getWritePtr(frame, 1);
-        uint16_t *v = (uint16_t *)vsapi->getWritePtr(frame, 2);
-        intptr_t stride = vsapi->getStride(frame, 0) / sizeof(uint16_t);
-        if (resolution == NTSC || resolution == NTSC_4FSC)
+static void draw_span(uint8_t *row, const ColorBarsSpan *span, const ColorBarsPlane *plane, const ColorBarsKernels *k, const VSVideoFormat *f)
+{
+    const int n = span->width;
+    if (f->sampleType == stFloat)
+    {
+        float *dst = (float *)row + span->x;
+        if (span->slope == 0.0f)
+            k->fill_f32(dst, n, span->base);
+        else
+            k->ramp_f32(dst, n, span->base, span->slope);
+    }
+    else if (f->bytesPerSample == 1)
+    {
+        uint8_t *dst = row + span->x;
+        if (span->slope == 0.0f)
+            k->fill_u8(dst, n, (uint8_t)span->base);
+        else
         {
-            // pattern 1
-            for (int h = 0; h < ntsc_heights[compat][0]; h++)
-            {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int bar = 0; bar < 9; bar++)
-                    for (int i = 0; i < p1_widths[resolution][compat][bar]; i++, edge_y++, edge_u++, edge_v++)
-                    {
-                        *edge_y = ntsc1_y[depth][bar];
-                        *edge_u = ntsc1_u[depth][bar];
-                        *edge_v = ntsc1_v[depth][bar];
-                    }
-                y += stride;
-                u += stride;
-                v += stride;
-            }
-            // pattern 2
-            for (int h = 0; h < ntsc_heights[compat][1]; h++)
-            {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int bar = 0; bar < 9; bar++)
-                    for (int i = 0; i < p1_widths[resolution][compat][bar]; i++, edge_y++, edge_u++, edge_v++)
-                    {
-                        *edge_y = ntsc2_y[depth][bar];
-                        *edge_u = ntsc2_u[depth][bar];
-                        *edge_v = ntsc2_v[depth][bar];
-                    }
-                y += stride;
-                u += stride;
-                v += stride;
-            }
-            // pattern 3
-            for (int h = 0; h < ntsc_heights[compat][2]; h++)
-            {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int bar = 0; bar < 10; bar++)
-                    for (int i = 0; i < p4_widths[resolution][compat][bar]; i++, edge_y++, edge_u++, edge_v++)
-                    {
-                        *edge_y = ntsc3_y[depth][bar];
-                        *edge_u = ntsc3_u[depth][bar];
-                        *edge_v = ntsc3_v[depth][bar];
-                    }
-                y += stride;
-                u += stride;
-                v += stride;
-            }
-            if (d->halfline)
-            {
-                int blank_y = 64 * (depth * 4);
-                int blank_c = 512 * (depth * 4);
-
-                uint16_t* edge_y = (uint16_t*)vsapi->getWritePtr(frame, 0);
-                uint16_t* edge_u = (uint16_t*)vsapi->getWritePtr(frame, 1);
-                uint16_t* edge_v = (uint16_t*)vsapi->getWritePtr(frame, 2);
-                // video starts 41.259 us after 0H
-                int blankposition = resolution == NTSC_4FSC ? 461 : 413;
-                for (int i = 0; i < blankposition; i++)
-                {
-                    edge_y[i] = blank_y;
-                    edge_u[i] = blank_c;
-                    edge_v[i] = blank_c;
-                }
-
-                edge_y = (uint16_t*)vsapi->getWritePtr(frame, 0);
-                edge_u = (uint16_t*)vsapi->getWritePtr(frame, 1);
-                edge_v = (uint16_t*)vsapi->getWritePtr(frame, 2);
-                // video ends 30.592 us after 0H
-                blankposition = resolution == NTSC_4FSC ? 309 : 291;
-                edge_y += stride * (height - 1);
-                edge_u += stride * (height - 1);
-                edge_v += stride * (height - 1);
-                for (int i = blankposition; i < width; i++)
-                {
-                    edge_y[i] = blank_y;
-                    edge_u[i] = blank_c;
-                    edge_v[i] = blank_c;
-                }
-            }
+            k->ramp_u8(dst, n, span->base, span->slope);
+            // rounded ramps can end one code past the legal range
+            for (int i = 0; i < n; i++)
+                dst[i] = dst[i] < plane->lo ? plane->lo : dst[i] > plane->hi ? plane->hi : dst[i];
         }
-        else if (resolution == PAL || resolution == PAL_4FSC)
+    }
+    else
+    {
+        uint16_t *dst = (uint16_t *)row + span->x;
+        if (span->slope == 0.0f)
+            k->fill(dst, n, (uint16_t)span->base);
+        else
         {
-            for (int h = 0; h < height; h++)
-            {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int bar = 0; bar < 10; bar++)
-                    for (int i = 0; i < p1_widths[resolution][compat][bar]; i++, edge_y++, edge_u++, edge_v++)
-                    {
-                        *edge_y = pal_y[depth][bar];
-                        *edge_u = pal_u[depth][bar];
-                        *edge_v = pal_v[depth][bar];
-                    }
-                y += stride;
-                u += stride;
-                v += stride;
-            }
-            if (d->halfline)
-            {
-                int blank_y = 64 * (depth * 4);
-                int blank_c = 512 * (depth * 4);
-
-                uint16_t* edge_y = (uint16_t*)vsapi->getWritePtr(frame, 0);
-                uint16_t* edge_u = (uint16_t*)vsapi->getWritePtr(frame, 1);
-                uint16_t* edge_v = (uint16_t*)vsapi->getWritePtr(frame, 2);
-                // video starts 42.5 us after 0H
-                int blankposition = resolution == PAL_4FSC ? 580 : 410;
-                for (int i = 0; i < blankposition; i++)
-                {
-                    edge_y[i] = blank_y;
-                    edge_u[i] = blank_c;
-                    edge_v[i] = blank_c;
-                }
-
-                edge_y = (uint16_t*)vsapi->getWritePtr(frame, 0);
-                edge_u = (uint16_t*)vsapi->getWritePtr(frame, 1);
-                edge_v = (uint16_t*)vsapi->getWritePtr(frame, 2);
-                // video ends 30.35 us after 0H
-                blankposition = resolution == PAL_4FSC ? 365 : 278;
-                edge_y += stride * (height - 1);
-                edge_u += stride * (height - 1);
-                edge_v += stride * (height - 1);
-                for (int i = blankposition; i < width; i++)
-                {
-                    edge_y[i] = blank_y;
-                    edge_u[i] = blank_c;
-                    edge_v[i] = blank_c;
-                }
-            }
+            k->ramp(dst, n, span->base, span->slope);
+            for (int i = 0; i < n; i++)
+                dst[i] = dst[i] < plane->lo ? plane->lo : dst[i] > plane->hi ? plane->hi : dst[i];
         }
-        else if ( hdr ) // HDR systems
+    }
+}
+
+void colorbars_draw_band(const ColorBarsData *d, const ColorBarsPlane *plane, int band, uint8_t *row)
+{
+    const ColorBarsBand *b = &plane->bands[band];
+    for (int s = b->span; s < b->span + b->num_spans; s++)
+        draw_span(row, &plane->spans[s], plane, d->kernels, &d->vi.format);
+}
+
+// The part of the raster one plane of the clip shows, in samples and rows of that plane
+typedef struct {
+    int left;
+    int top;
+    int width;
+    int raster; // width of the whole raster
+    int pair; // 2SI: samples per pair, every other pair starting with pair phase is shown
+    int phase;
+} PlaneWindow;
+
+// Executes the compiled layout of rows y0 to y1 of one plane: draw the first row of each band, then
+// copy it down.  With a shape kernel, the transitions are shaped before the row is copied.  A
+// window narrower than the raster is drawn in raster coordinates into line, only the spans that
+// reach it (or the samples its shaping reads), and then copied out, or gathered for 2SI, so a
+// window has the same samples as the whole raster.  With band_ns, the time spent on each band is
+// added to it.
+static void render_plane(const ColorBarsPlane *plane, const ColorBarsKernels *k, const VSVideoFormat *f, uint8_t *dst, ptrdiff_t stride, const PlaneWindow *w,
+                         int y0, int y1, const ShapeKernel *shape, uint8_t *line, uint8_t *scratch, int64_t *band_ns)
+{
+    const size_t rowsize = (size_t)w->width * f->bytesPerSample;
+    const int cropped = w->width != w->raster;
+    const int x0 = w->left - (shape ? shape->radius : 0);
+    const int x1 = w->left + (w->pair ? w->raster : w->width) + (shape ? shape->radius : 0);
+    for (int i = 0; i < plane->num_bands; i++)
+    {
+        const ColorBarsBand *band = &plane->bands[i];
+        const int top = band->y > y0 + w->top ? band->y : y0 + w->top;
+        const int bottom = band->y + band->height < y1 + w->top ? band->y + band->height : y1 + w->top;
+        if (bottom <= top)
+            continue;
+        const int64_t start = band_ns ? colorbars_clock_ns() : 0;
+        uint8_t *row = dst + (top - w->top) * stride;
+        uint8_t *out = cropped ? line : row;
+        for (int s = band->span; s < band->span + band->num_spans; s++)
+            if (plane->spans[s].x < x1 && plane->spans[s].x + plane->spans[s].width > x0)
+                draw_span(out, &plane->spans[s], plane, k, f);
+        if (shape)
         {
-            // pattern 1 - 100% top strip
-            for (int h = 0; h < height / 12; h++)
-            {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int bar = 0; bar < 9; bar++)
-                    for (int i = 0; i < hdr_p1_widths[resolution-3][bar]; i++, edge_y++, edge_u++, edge_v++)
-                    {
-                        *edge_y = hdr_p1_r[hdr-1][depth][bar];
-                        *edge_u = hdr_p1_g[hdr-1][depth][bar];
-                        *edge_v = hdr_p1_b[hdr-1][depth][bar];
-                    }
-                y += stride;
-                u += stride;
-                v += stride;
-            }
-            // pattern 2 - 75%/58% bars
-            for (int h = 0; h < height / 2; h++)
-            {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int bar = 0; bar < 9; bar++)
-                    for (int i = 0; i < hdr_p1_widths[resolution - 3][bar]; i++, edge_y++, edge_u++, edge_v++)
-                    {
-                        *edge_y = hdr_p2_r[hdr - 1][depth][bar];
-                        *edge_u = hdr_p2_g[hdr - 1][depth][bar];
-                        *edge_v = hdr_p2_b[hdr - 1][depth][bar];
-                    }
-                y += stride;
-                u += stride;
-                v += stride;
-            }
-            // pattern 3 - grayscale
-            for (int h = 0; h < height / 12; h++)
-            {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int bar = 0; bar < 15; bar++)
-                    for (int i = 0; i < hdr_p3_widths[resolution - 3][bar]; i++, edge_y++, edge_u++, edge_v++)
-                        *edge_y = *edge_u = *edge_v = hdr_p3_gray[hdr - 1][depth][bar];
-                y += stride;
-                u += stride;
-                v += stride;
-            }
-            // pattern 4 - ramp
-            for (int h = 0; h < height / 12; h++)
-            {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int bar = 0; bar < 2; bar++)
-                    for (int i = 0; i < hdr_p4_widths[depth][hdr - 1][resolution - 3][bar]; i++, edge_y++, edge_u++, edge_v++)
-                        *edge_y = *edge_u = *edge_v = hdr_p4_gray[hdr - 1][depth][bar];
-                uint16_t rampwidth = hdr_p4_widths[depth][hdr - 1][resolution - 3][2];
-                uint16_t rampheight = hdr_p4_gray[hdr - 1][depth][2] - hdr_p4_gray[hdr - 1][depth][1];
-                float slope = (float)rampheight / (float)rampwidth;
-                for (int i = 0; i < rampwidth; i++, edge_y++, edge_u++, edge_v++)
-                    *edge_y = *edge_u = *edge_v = (int)(hdr_p4_gray[hdr - 1][depth][1] + i * slope);
-                for (int i = 0; i < hdr_p4_widths[depth][hdr - 1][resolution - 3][3]; i++, edge_y++, edge_u++, edge_v++)
-                    *edge_y = *edge_u = *edge_v = hdr_p4_gray[hdr - 1][depth][2];
-                y += stride;
-                u += stride;
-                v += stride;
-            }
-            // pattern 5 - 75%/58% 709 bars
-            for (int h = 0; h < height / 4; h++)
-            {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int bar = 0; bar < 15; bar++)
-                    for (int i = 0; i < hdr_p5_widths[resolution - 3][bar]; i++, edge_y++, edge_u++, edge_v++)
-                    {
-                        *edge_y = hdr_p5_r[hdr - 1][depth][bar];
-                        *edge_u = hdr_p5_g[hdr - 1][depth][bar];
-                        *edge_v = hdr_p5_b[hdr - 1][depth][bar];
-                    }
-                y += stride;
-                u += stride;
-                v += stride;
-            }
+            memcpy(scratch, out, (size_t)w->raster * f->bytesPerSample);
+            for (int s = band->span; s < band->span + band->num_spans; s++)
+                if (plane->spans[s].x > 0 && plane->spans[s].x - shape->radius < x1 && plane->spans[s].x + shape->radius > x0)
+                    shape_edge(out, scratch, w->raster, plane->spans[s].x, shape, f);
         }
-        else // HD and higher SDR systems
+        if (w->pair)
         {
-            // pattern 1
-            for (int h = 0; h < height / 12 * 7; h++)
-            {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int bar = 0; bar < 9; bar++)
-                    for (int i = 0; i < p1_widths[resolution][compat][bar]; i++, edge_y++, edge_u++, edge_v++)
-                    {
-                        *edge_y = p1_y[wcg][depth][bar];
-                        *edge_u = p1_u[wcg][depth][bar];
-                        *edge_v = p1_v[wcg][depth][bar];
-                    }
-                y += stride;
-                u += stride;
-                v += stride;
-            }
-            // pattern 2
-            for (int h = 0; h < height / 12; h++)
-            {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int i = 0; i < p1_widths[resolution][compat][0]; i++, edge_y++, edge_u++, edge_v++)
-                {
-                    *edge_y = p2_y[wcg][depth][0];
-                    *edge_u = p2_u[wcg][depth][0];
-                    *edge_v = p2_v[wcg][depth][0];
-                }
-                // sub-pattern *2: 100% white, -I, +I, or 75% white
-                int iqbar = iq ? iq + 8 : 1;
-                for (int i = 0; i < p1_widths[resolution][compat][1]; i++, edge_y++, edge_u++, edge_v++)
-                {
-                    *edge_y = p2_y[wcg][depth][iqbar];
-                    *edge_u = p2_u[wcg][depth][iqbar];
-                    *edge_v = p2_v[wcg][depth][iqbar];
-                }
-                for (int bar = 2; bar < 9; bar++)
-                    for (int i = 0; i < p1_widths[resolution][compat][bar]; i++, edge_y++, edge_u++, edge_v++)
-                    {
-                        *edge_y = p2_y[wcg][depth][bar];
-                        *edge_u = p2_u[wcg][depth][bar];
-                        *edge_v = p2_v[wcg][depth][bar];
-                    }
-                y += stride;
-                u += stride;
-                v += stride;
-            }
-            // pattern 3
-            for (int h = 0; h < height / 12; h++)
-            {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int i = 0; i < p1_widths[resolution][compat][0]; i++, edge_y++, edge_u++, edge_v++)
-                {
-                    *edge_y = p3_y[wcg][depth][0];
-                    *edge_u = p3_u[wcg][depth][0];
-                    *edge_v = p3_v[wcg][depth][0];
-                }
-                // sub-pattern *3: 0% black or +Q
-                int iqbar = iq == IQ_BOTH ? iq + 8 : 1;
-                for (int i = 0; i < p1_widths[resolution][compat][1]; i++, edge_y++, edge_u++, edge_v++)
-                {
-                    *edge_y = p3_y[wcg][depth][iqbar];
-                    *edge_u = p3_u[wcg][depth][iqbar];
-                    *edge_v = p3_v[wcg][depth][iqbar];
-                }
-                // Y ramp
-                uint16_t rampwidth = p1_widths[resolution][compat][2] + p1_widths[resolution][compat][3] +
-                    p1_widths[resolution][compat][4] + p1_widths[resolution][compat][5] +
-                    p1_widths[resolution][compat][6];
-                uint16_t rampheight = p3_y[wcg][depth][6] - p3_y[wcg][depth][2];
-                float slope = (float)rampheight / (float)rampwidth;
-                for (int i = 0; i < rampwidth; i++, edge_y++, edge_u++, edge_v++)
-                {
-                    *edge_y = (int)(p3_y[wcg][depth][2] + i * slope);
-                    *edge_u = p3_u[wcg][depth][2];
-                    *edge_v = p3_v[wcg][depth][2];
-                }
-                for (int bar = 7; bar < 9; bar++)
-                    for (int i = 0; i < p1_widths[resolution][compat][bar]; i++, edge_y++, edge_u++, edge_v++)
-                    {
-                        *edge_y = p3_y[wcg][depth][bar];
-                        *edge_u = p3_u[wcg][depth][bar];
-                        *edge_v = p3_v[wcg][depth][bar];
-                    }
-                y += stride;
-                u += stride;
-                v += stride;
-            }
-            // pattern 4a
-            for (int h = 0; h < height / 12; h++)
+            const size_t pairsize = (size_t)w->pair * f->bytesPerSample;
+            for (int x = 0; x < w->width / w->pair; x++)
+                memcpy(row + x * pairsize, line + (x * 2 + w->phase) * pairsize, pairsize);
+        }
+        else if (cropped)
+            memcpy(row, line + (size_t)w->left * f->bytesPerSample, rowsize);
+        for (int h = 1; h < bottom - top; h++)
+            memcpy(row + h * stride, row, rowsize);
+        if (band_ns)
+            __atomic_fetch_add(&band_ns[i], colorbars_clock_ns() - start, __ATOMIC_RELAXED);
+    }
+}
+
+// The first sample of the window at or right of raster sample x, or its width if there is none
+static int window_x(const PlaneWindow *w, int x)
+{
+    int i = x - w->left;
+    if (w->pair)
+    {
+        // the window has pair samples of every 2 * pair, starting at phase * pair
+        const int o = x % (2 * w->pair) - w->phase * w->pair;
+        i = x / (2 * w->pair) * w->pair + (o < 0 ? 0 : o < w->pair ? o : w->pair);
+    }
+    return i < 0 ? 0 : i > w->width ? w->width : i;
+}
+
+// The raster sample shown at sample i of the window
+static int raster_x(const PlaneWindow *w, int i)
+{
+    if (w->pair)
+        return i / w->pair * 2 * w->pair + w->phase * w->pair + i % w->pair;
+    return i + w->left;
+}
+
+// The value of a span at raster sample x, as draw_span writes it
+static double span_value(const ColorBarsSpan *span, const ColorBarsPlane *plane, int x, const VSVideoFormat *f)
+{
+    const float v = span->base + (x - span->x) * span->slope;
+    if (f->sampleType == stFloat)
+        return v;
+    if (span->slope == 0.0f)
+        return (int)span->base;
+    const int i = (int)v;
+    return i < plane->lo ? plane->lo : i > plane->hi ? plane->hi : i;
+}
+
+// Lists every patch the window shows, plane after plane: its plane, its rectangle (x, y, width
+// and height in samples of the plane) and the values of its first and last sample, which are the
+// same unless it is a ramp.  Shaped edges are part of the patches they lead into.
+static void set_geometry(const ColorBarsData *d, int field, const PlaneWindow *windows, const int *heights, VSMap *props, const VSAPI *vsapi)
+{
+    const VSVideoFormat *f = &d->vi.format;
+    for (int p = 0; p < f->numPlanes; p++)
+    {
+        const ColorBarsPlane *plane = &d->planes[field][p];
+        const PlaneWindow *w = &windows[p];
+        for (int b = 0; b < plane->num_bands; b++)
+        {
+            const ColorBarsBand *band = &plane->bands[b];
+            const int y0 = band->y - w->top < 0 ? 0 : band->y - w->top;
+            const int y1 = band->y + band->height - w->top > heights[p] ? heights[p] : band->y + band->height - w->top;
+            for (int s = band->span; s < band->span + band->num_spans && y0 < y1; s++)
             {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int bar = 0; bar < 11; bar++)
-                    for (int i = 0; i < p4_widths[resolution][compat][bar]; i++, edge_y++, edge_u++, edge_v++)
-                    {
-                        *edge_y = p4_y[depth][bar];
-                        *edge_u = p4_u[depth][bar];
-                        *edge_v = p4_v[depth][bar];
-                    }
-                y += stride;
-                u += stride;
-                v += stride;
+                const ColorBarsSpan *span = &plane->spans[s];
+                const int x0 = window_x(w, span->x);
+                const int x1 = window_x(w, span->x + span->width);
+                if (x1 <= x0)
+                    continue;
+                const int64_t rect[4] = { x0, y0, x1 - x0, y1 - y0 };
+                const double value[2] = { span_value(span, plane, raster_x(w, x0), f), span_value(span, plane, raster_x(w, x1 - 1), f) };
+                vsapi->mapSetInt(props, "ColorBarsPatchPlane", p, maAppend);
+                for (int i = 0; i < 4; i++)
+                    vsapi->mapSetInt(props, "ColorBarsPatchRect", rect[i], maAppend);
+                vsapi->mapSetFloat(props, "ColorBarsPatchValue", value[0], maAppend);
+                vsapi->mapSetFloat(props, "ColorBarsPatchValue", value[1], maAppend);
             }
-            // pattern 4b
-            for (int h = 0; h < height / 12; h++)
+        }
+    }
+}
+
+// Frames smaller than this are rendered on the calling thread, starting threads would cost more
+#define RENDER_THREAD_PIXELS (1920 * 1080)
+
+// The first render is split into jobs of one row range of one plane, handed out to the workers
+// through a shared counter.  Every job owns its rows, so no other synchronization is needed.
+typedef struct {
+    const ColorBarsData *d;
+    int field;
+    uint8_t *ptr[3];
+    ptrdiff_t stride[3];
+    PlaneWindow window[3];
+    int height[3];
+    int64_t *band_ns[3]; // with stats, summed over the threads that rendered each band
+    int jobs_per_plane;
+    int num_jobs;
+    int next;
+} RenderJobs;
+
+#ifdef _WIN32
+static DWORD WINAPI render_worker(LPVOID arg)
+#else
+static void *render_worker(void *arg)
+#endif
+{
+    RenderJobs *jobs = (RenderJobs *)arg;
+    const ColorBarsData *d = jobs->d;
+    const VSVideoFormat *f = &d->vi.format;
+    // raster wide, zeroed so samples left undrawn outside the window are never garbage
+    const size_t rowsize = (size_t)d->raster_width * f->bytesPerSample;
+    uint8_t *line = d->raster_width != d->vi.width ? (uint8_t *)calloc(1, rowsize) : NULL;
+    uint8_t *scratch = d->filter ? (uint8_t *)calloc(1, rowsize) : NULL;
+    for (int j = __atomic_fetch_add(&jobs->next, 1, __ATOMIC_RELAXED); j < jobs->num_jobs;
+             j = __atomic_fetch_add(&jobs->next, 1, __ATOMIC_RELAXED))
+    {
+        const int p = j / jobs->jobs_per_plane;
+        const int c = j % jobs->jobs_per_plane;
+        const int h = jobs->height[p];
+        const ShapeKernel *shape = !d->filter ? NULL : p && f->subSamplingW ? &shape_half : &shape_full;
+        render_plane(&d->planes[jobs->field][p], d->kernels, f, jobs->ptr[p], jobs->stride[p], &jobs->window[p],
+                     (int)((int64_t)h * c / jobs->jobs_per_plane), (int)((int64_t)h * (c + 1) / jobs->jobs_per_plane), shape, line, scratch, jobs->band_ns[p]);
+    }
+    free(line);
+    free(scratch);
+    return 0;
+}
+
+void colorbars_levels(const ColorBarsData *d, float *black, float *white, float *neutral)
+{
+    const VSVideoFormat *f = &d->vi.format;
+    *black = 0.0f;
+    *white = 1.0f;
+    *neutral = 0.0f;
+    if (f->sampleType == stInteger)
+    {
+        *black = d->hdr == 3 ? 0 : 16 << (f->bitsPerSample - 8);
+        *white = d->hdr == 3 ? (1 << f->bitsPerSample) - 1 : 235 << (f->bitsPerSample - 8);
+        *neutral = 128 << (f->bitsPerSample - 8);
+    }
+}
+
+int colorbars_raster_x(const ColorBarsData *d, int x)
+{
+    if (d->division == DIVISION_2SI)
+        return (x >> 1) * 4 + (d->subimage & 1) * 2 + (x & 1);
+    return x + d->left;
+}
+
+int colorbars_raster_y(const ColorBarsData *d, int y)
+{
+    if (d->division == DIVISION_2SI)
+        return y * 2 + (d->subimage >> 1);
+    return y + d->top;
+}
+
+void colorbars_set_props(const ColorBarsData *d, int field, VSMap *props, const VSAPI *vsapi)
+{
+    const int resolution = d->resolution;
+    const int hdr = d->hdr;
+    const int wcg = d->wcg;
+    const int depth = d->vi.format.bitsPerSample <= 10 ? 0 : 1;
+
+    if (hdr)
+    {
+        vsapi->mapSetInt(props, "_Matrix", VSC_MATRIX_RGB, maReplace);
+        vsapi->mapSetInt(props, "_Transfer", hdr == 1 ? VSC_TRANSFER_ARIB_B67 : VSC_TRANSFER_ST2084, maReplace);
+        vsapi->mapSetInt(props, "_Primaries", VSC_PRIMARIES_BT2020, maReplace);
+        vsapi->mapSetInt(props, "_SARNum", 1, maReplace);
+        vsapi->mapSetInt(props, "_SARDen", 1, maReplace);
+    }
+    else
+    {
+        if (resolution < HD720 || resolution > UHDTV2)
+        {
+            if (resolution == PAL || resolution == PAL_4FSC)
             {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int i = 0; i < p4_widths[resolution][compat][0]; i++, edge_y++, edge_u++, edge_v++)
-                {
-                    *edge_y = p4_y[depth][0];
-                    *edge_u = p4_u[depth][0];
-                    *edge_v = p4_v[depth][0];
-                }
-                // sub black
-                const int subblack = d->subblack;
-                uint16_t rampwidth = p4_widths[resolution][compat][1] / 2;
-                uint16_t rampheight = p4_y[depth][1] - p4_y[depth][11];
-                float slope = (float)subblack * (float)rampheight / (float)rampwidth;
-                for (int i = 0; i < rampwidth; i++, edge_y++, edge_u++, edge_v++)
-                {
-                    *edge_y = (int)(p4_y[depth][1] - i * slope);
-                    *edge_u = p4_u[depth][1];
-                    *edge_v = p4_v[depth][1];
-                }
-                for (int i = 0; i < rampwidth; i++, edge_y++, edge_u++, edge_v++)
-                {
-                    *edge_y = (int)(p4_y[depth][1 + subblack * 10] + i * slope);
-                    *edge_u = p4_u[depth][1];
-                    *edge_v = p4_v[depth][1];
-                }
-                // super-white
-                const int superwhite = d->superwhite;
-                rampwidth = p4_widths[resolution][compat][2] / 2;
-                rampheight = p4_y[depth][12] - p4_y[depth][2];
-                slope = (float)superwhite * (float)rampheight / (float)rampwidth;
-                for (int i = 0; i < rampwidth; i++, edge_y++, edge_u++, edge_v++)
-                {
-                    *edge_y = (int)(p4_y[depth][2] + i * slope);
-                    *edge_u = p4_u[depth][2];
-                    *edge_v = p4_v[depth][2];
-                }
-                for (int i = 0; i < rampwidth; i++, edge_y++, edge_u++, edge_v++)
-                {
-                    *edge_y = (int)(p4_y[depth][2 + superwhite * 10] - i * slope);
-                    *edge_u = p4_u[depth][2];
-                    *edge_v = p4_v[depth][2];
-                }
-                for (int bar = 3; bar < 11; bar++)
-                    for (int i = 0; i < p4_widths[resolution][compat][bar]; i++, edge_y++, edge_u++, edge_v++)
-                    {
-                        *edge_y = p4_y[depth][bar];
-                        *edge_u = p4_u[depth][bar];
-                        *edge_v = p4_v[depth][bar];
-                    }
-                y += stride;
-                u += stride;
-                v += stride;
+                vsapi->mapSetInt(props, "_Matrix", VSC_MATRIX_BT470_BG, maReplace);
+                vsapi->mapSetInt(props, "_Primaries", VSC_PRIMARIES_BT470_BG, maReplace);
+                vsapi->mapSetInt(props, "_SARNum", resolution == PAL ? 128 : 547, maReplace);
+                vsapi->mapSetInt(props, "_SARDen", resolution == PAL ? 117 : 657, maReplace);
             }
-            // pattern 4c
-            for (int h = 0; h < height / 12; h++)
+            else
             {
-                uint16_t *edge_y = y;
-                uint16_t *edge_u = u;
-                uint16_t *edge_v = v;
-                for (int bar = 0; bar < 11; bar++)
-                    for (int i = 0; i < p4_widths[resolution][compat][bar]; i++, edge_y++, edge_u++, edge_v++)
-                    {
-                        *edge_y = p4_y[depth][bar];
-                        *edge_u = p4_u[depth][bar];
-                        *edge_v = p4_v[depth][bar];
-                    }
-                y += stride;
-                u += stride;
-                v += stride;
+                vsapi->mapSetInt(props, "_Matrix", VSC_MATRIX_ST170_M, maReplace);
+                vsapi->mapSetInt(props, "_Primaries", VSC_PRIMARIES_ST170_M, maReplace);
+                vsapi->mapSetInt(props, "_SARNum", resolution == NTSC ? 4320 : 352, maReplace);
+                vsapi->mapSetInt(props, "_SARDen", resolution == NTSC ? 4739 : 413, maReplace);
             }
+            vsapi->mapSetInt(props, "_Transfer", VSC_TRANSFER_BT601, maReplace);
+        }
+        else
+        {
+            vsapi->mapSetInt(props, "_Matrix",    wcg ? VSC_MATRIX_BT2020_NCL : VSC_MATRIX_BT709, maReplace);
+            vsapi->mapSetInt(props, "_Transfer", !wcg ? VSC_TRANSFER_BT709 :
+                                                depth ? VSC_TRANSFER_BT2020_12 : VSC_TRANSFER_BT2020_10, maReplace);
+            vsapi->mapSetInt(props, "_Primaries", wcg ? VSC_PRIMARIES_BT2020 : VSC_PRIMARIES_BT709, maReplace);
+            vsapi->mapSetInt(props, "_SARNum", 1, maReplace);
+            vsapi->mapSetInt(props, "_SARDen", 1, maReplace);
         }
+    }
+    // limited, unless full range PQ or float, which is normalized
+    vsapi->mapSetInt(props, "_ColorRange", hdr == 3 || d->vi.format.sampleType == stFloat ? 0 : 1, maReplace);
+    if (d->vi.format.subSamplingW || d->vi.format.subSamplingH)
+        vsapi->mapSetInt(props, "_ChromaLocation", VSC_CHROMA_LEFT, maReplace);
+    if (d->scan == SCAN_INTERLACED)
+        vsapi->mapSetInt(props, "_FieldBased", d->bff ? VSC_FIELD_BOTTOM : VSC_FIELD_TOP, maReplace);
+    else if (d->scan == SCAN_FIELDS)
+    {
+        vsapi->mapSetInt(props, "_FieldBased", VSC_FIELD_PROGRESSIVE, maReplace);
+        vsapi->mapSetInt(props, "_Field", field ? 0 : 1, maReplace); // 1 is the top field
+    }
+    vsapi->mapSetInt(props, "_DurationNum", d->vi.fpsDen, maReplace);
+    vsapi->mapSetInt(props, "_DurationDen", d->vi.fpsNum, maReplace);
+}
+
+VSFrame *colorbars_render(const ColorBarsData *d, int field, VSCore *core, const VSAPI *vsapi)
+{
+    const int64_t start = colorbars_clock_ns();
+    VSFrame *frame = vsapi->newVideoFrame(&d->vi.format, d->vi.width, d->vi.height, 0, core);
+    colorbars_set_props(d, field, vsapi->getFramePropertiesRW(frame), vsapi);
+
+    RenderJobs jobs = { 0 };
+    jobs.d = d;
+    jobs.field = field;
+    for (int p = 0; p < d->vi.format.numPlanes; p++)
+    {
+        jobs.ptr[p] = vsapi->getWritePtr(frame, p);
+        jobs.stride[p] = vsapi->getStride(frame, p);
+        const int ssw = p ? d->vi.format.subSamplingW : 0;
+        const int ssh = p ? d->vi.format.subSamplingH : 0;
+        jobs.window[p].left = d->left >> ssw;
+        jobs.window[p].top = d->top >> ssh;
+        jobs.window[p].width = vsapi->getFrameWidth(frame, p);
+        jobs.window[p].raster = d->raster_width >> ssw;
+        jobs.window[p].pair = d->division == DIVISION_2SI ? 2 >> ssw : 0;
+        jobs.window[p].phase = d->subimage & 1;
+        jobs.height[p] = vsapi->getFrameHeight(frame, p);
+        if (d->stats)
+            jobs.band_ns[p] = (int64_t *)calloc(d->planes[field][p].num_bands, sizeof(int64_t));
+    }
+
+    // one worker per core thread, each plane cut into a couple of bands per worker to even out the load
+    VSCoreInfo info;
+    vsapi->getCoreInfo(core, &info);
+    int threads = d->reference || (int64_t)d->vi.width * d->vi.height < RENDER_THREAD_PIXELS ? 1 : info.numThreads;
+    threads = threads < 1 ? 1 : threads > 64 ? 64 : threads;
+    jobs.jobs_per_plane = threads > 1 ? threads * 2 : 1;
+    jobs.num_jobs = jobs.jobs_per_plane * d->vi.format.numPlanes;
+
+#ifdef _WIN32
+    HANDLE workers[64];
+#else
+    pthread_t workers[64];
+#endif
+    int started = 0;
+    for (; started < threads - 1; started++)
+    {
+#ifdef _WIN32
+        if (!(workers[started] = CreateThread(NULL, 0, render_worker, &jobs, 0, NULL)))
+            break;
+#else
+        if (pthread_create(&workers[started], NULL, render_worker, &jobs))
+            break;
+#endif
+    }
+    // the calling thread works too, and finishes alone if no thread could be started
+    render_worker(&jobs);
+    for (int i = 0; i < started; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(workers[i], INFINITE);
+        CloseHandle(workers[i]);
+#else
+        pthread_join(workers[i], NULL);
+#endif
+    }
+
+    if (d->geometry)
+        set_geometry(d, field, jobs.window, jobs.height, vsapi->getFramePropertiesRW(frame), vsapi);
+
+    int64_t bytes = 0;
+    for (int p = 0; p < d->vi.format.numPlanes; p++)
+        bytes += (int64_t)jobs.window[p].width * jobs.height[p] * d->vi.format.bytesPerSample;
+    const int64_t ns = colorbars_clock_ns() - start;
+    colorbars_count_render(ns, bytes);
+    if (d->stats)
+    {
+        VSMap *props = vsapi->getFramePropertiesRW(frame);
+        colorbars_set_stats(d, props, ns, bytes, vsapi);
+        // band times of every plane in turn, with the band count of each plane
+        for (int p = 0; p < d->vi.format.numPlanes; p++)
+        {
+            vsapi->mapSetInt(props, "ColorBarsBands", d->planes[field][p].num_bands, maAppend);
+            for (int i = 0; i < d->planes[field][p].num_bands; i++)
+                vsapi->mapSetInt(props, "ColorBarsBandNs", jobs.band_ns[p][i], maAppend);
+            free(jobs.band_ns[p]);
+        }
+    }
+    return frame;
+}
+
+static const VSFrame *VS_CC colorbarsGetFrame (int n, int activationReason, void* instanceData, void** frameData, VSFrameContext* frameCtx, VSCore* core, const VSAPI* vsapi)
+{
+    ColorBarsData *d = (ColorBarsData*)instanceData;
+    if (activationReason == arInitial)
+    {
+        if (d->pattern == PATTERN_ZONEPLATE)
+        {
+            VSFrame *frame = colorbars_zoneplate_render(d, n, core, vsapi);
+            if (d->timecode)
+                colorbars_draw_counter(d, frame, n, vsapi);
+            return frame;
+        }
+        // the pattern never changes, so hand out references to the first render
+        const int field = d->scan == SCAN_FIELDS ? (n & 1) ^ d->bff : 0;
+        if (!d->frame[field])
+            d->frame[field] = colorbars_shared_frame(d, field, core, vsapi);
+        else
+            colorbars_count_lookup(1);
+        if (!d->timecode)
+            return vsapi->addFrameRef(d->frame[field]);
+        // a copy of the cached frame with only the counter rows redrawn
+        VSFrame *frame = vsapi->copyFrame(d->frame[field], core);
+        colorbars_draw_counter(d, frame, n, vsapi);
         return frame;
     }
     return 0;
@@ -822,26 +1309,40 @@ static const VSFrame *VS_CC colorbarsGetFrame (int n, int activationReason, void
 static void VS_CC colorbarsFree( void *instanceData, VSCore *core, const VSAPI *vsapi )
 {
     ColorBarsData *d = (ColorBarsData *)instanceData;
+    colorbars_prerender_join( d );
+    vsapi->freeFrame( d->frame[0] );
+    vsapi->freeFrame( d->frame[1] );
+    colorbars_unshare( d, vsapi );
+    colorbars_free_layout( d );
     free( d );
 }
 
-static void VS_CC colorbarsCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
+const char *colorbars_parse(ColorBarsData *d, const VSMap *in, VSCore *core, const VSAPI *vsapi)
 {
-    ColorBarsData d = { 0 };
-    ColorBarsData *data;
-
     int err = 0;
-    d.compatability = vsapi->mapGetIntSaturated(in, "compatability", 0, &err);
+    d->pattern = vsapi->mapGetIntSaturated(in, "pattern", 0, &err);
+    if (err)
+        d->pattern = PATTERN_BARS;
+    if (d->pattern < PATTERN_BARS || d->pattern > PATTERN_ZONEPLATE)
+        return "ColorBars: invalid pattern";
+    d->speed = (float)vsapi->mapGetFloat(in, "speed", 0, &err);
+    if (err)
+        d->speed = 0.05f;
+    // more than half a turn per frame only aliases back to slower motion
+    if (!(d->speed >= -0.5f && d->speed <= 0.5f))
+        return "ColorBars: zone plate speed must be between -0.5 and 0.5";
+
+    d->compatability = vsapi->mapGetIntSaturated(in, "compatability", 0, &err);
     if (err)
-        d.compatability = 2;
-    if (d.compatability < 0 || d.compatability > 2)
-        RETERROR( "ColorBars: invalid compatability mode" );
+        d->compatability = 2;
+    if (d->compatability < 0 || d->compatability > 2)
+        return "ColorBars: invalid compatability mode";
 
-    d.resolution = vsapi->mapGetInt(in, "resolution", 0, &err);
+    d->resolution = vsapi->mapGetInt(in, "resolution", 0, &err);
     if (err)
-        d.resolution = HD1080;
-    if (d.resolution < NTSC || d.resolution > PAL_4FSC)
-        RETERROR("ColorBars: invalid resolution");
+        d->resolution = HD1080;
+    if (d->resolution < NTSC || d->resolution > PAL_4FSC)
+        return "ColorBars: invalid resolution";
 
     const int resolutions[10][4] = { {  720,  486, 30000, 1001 },
                                      {  720,  576,    25,    1 },
@@ -853,103 +1354,354 @@ static void VS_CC colorbarsCreate(const VSMap *in, VSMap *out, void *userData, V
                                      { 7680, 4320, 60000, 1001 },
                                      {  768,  486, 30000, 1001 },
                                      {  948,  576,    25,    1 } };
-    d.vi.width = resolutions[d.resolution][0];
-    d.vi.height = resolutions[d.resolution][1];
-    if (d.compatability == 2 && (d.resolution == NTSC || d.resolution == NTSC_4FSC))
-        d.vi.height = 480;
-    d.hdr = vsapi->mapGetIntSaturated(in, "hdr", 0, &err);
+    d->vi.width = resolutions[d->resolution][0];
+    d->vi.height = resolutions[d->resolution][1];
+    if (d->compatability == 2 && (d->resolution == NTSC || d->resolution == NTSC_4FSC))
+        d->vi.height = 480;
+    d->hdr = vsapi->mapGetIntSaturated(in, "hdr", 0, &err);
     if (err)
-        d.hdr = 0;
-    if (d.hdr < 0 || d.hdr > 3)
-        RETERROR("ColorBars: invalid HDR mode");
+        d->hdr = 0;
+    if (d->hdr < 0 || d->hdr > 3)
+        return "ColorBars: invalid HDR mode";
 
     int pixformat = vsapi->mapGetIntSaturated(in, "format", 0, &err);
     if (err)
-        RETERROR("ColorBars: invalid format");
+        return "ColorBars: invalid format";
 
-    vsapi->getVideoFormatByID(&d.vi.format, pixformat, core);
-    if (!d.hdr && pixformat != pfYUV444P12 && pixformat != pfYUV444P10)
-        RETERROR("ColorBars: invalid format, only YUV444P10 and YUV444P12 for SDR formats");
-    if (d.hdr && pixformat != pfRGB30 && pixformat != pfRGB36)
-        RETERROR( "ColorBars: invalid format, only RGB30 and RGB36 for HDR formats");
+    vsapi->getVideoFormatByID(&d->vi.format, pixformat, core);
+    if (!d->hdr && (d->vi.format.colorFamily != cfYUV || d->vi.format.subSamplingW > 1 ||
+                    d->vi.format.subSamplingH > d->vi.format.subSamplingW))
+        return "ColorBars: invalid format, only YUV444, YUV422 and YUV420 for SDR formats";
+    if (d->hdr && d->vi.format.colorFamily != cfRGB)
+        return "ColorBars: invalid format, only RGB for HDR formats";
+    if (d->vi.format.sampleType == stInteger ? d->vi.format.bitsPerSample < 8 || d->vi.format.bitsPerSample > 16
+                                             : d->vi.format.bitsPerSample != 32)
+        return "ColorBars: invalid format, only 8 to 16-bit integer and 32-bit float";
 
-    d.subblack = vsapi->mapGetIntSaturated(in, "subblack", 0, &err);
+    // a layout file replaces the pattern and its raster, the system still sets the colorimetry
+    // and frame rate
+    const char *path = vsapi->mapGetData(in, "layout", 0, &err);
+    if (!err)
+    {
+        if (d->pattern != PATTERN_BARS)
+            return "ColorBars: layout is only valid for the bars";
+        d->layout = (ColorBarsLayoutFile *)malloc(sizeof(ColorBarsLayoutFile));
+        if (colorbars_layout_load(d->layout, path, d->error, sizeof(d->error)))
+            return d->error;
+        if (d->layout->width % (1 << d->vi.format.subSamplingW) || d->layout->height % (1 << d->vi.format.subSamplingH))
+            return "ColorBars: the layout raster must be a multiple of the subsampling";
+        d->vi.width = d->layout->width;
+        d->vi.height = d->layout->height;
+        d->layout_hash = d->layout->hash;
+    }
+
+    // any other raster keeps the system's colorimetry, frame rate and defaults
+    const int native_width = d->vi.width;
+    const int native_height = d->vi.height;
+    d->vi.width = vsapi->mapGetIntSaturated(in, "width", 0, &err);
+    if (err)
+        d->vi.width = native_width;
+    d->vi.height = vsapi->mapGetIntSaturated(in, "height", 0, &err);
+    if (err)
+        d->vi.height = native_height;
+    d->scaled = d->vi.width != native_width || d->vi.height != native_height;
+    if (d->scaled && d->layout)
+        return "ColorBars: width and height are set by the layout file";
+    if (d->scaled)
+    {
+        if (d->pattern == PATTERN_BARS && (d->resolution < HD720 || d->resolution > UHDTV2))
+            return "ColorBars: width and height are only valid with 720p and higher systems";
+        if (d->vi.width < 128 || d->vi.height < 72 || d->vi.width > 16384 || d->vi.height > 16384)
+            return "ColorBars: width and height must be from 128x72 to 16384x16384";
+        if (d->vi.width % (1 << d->vi.format.subSamplingW) || d->vi.height % (1 << d->vi.format.subSamplingH))
+            return "ColorBars: width and height must be multiples of the chroma subsampling";
+    }
+
+    d->subblack = vsapi->mapGetIntSaturated(in, "subblack", 0, &err);
     if (err)
-        d.subblack = 1;
-    d.subblack = !!d.subblack;
-    d.superwhite = vsapi->mapGetIntSaturated(in, "superwhite", 0, &err);
+        d->subblack = 1;
+    d->subblack = !!d->subblack;
+    d->superwhite = vsapi->mapGetIntSaturated(in, "superwhite", 0, &err);
     if (err)
-        d.superwhite = 1;
-    d.superwhite = !!d.superwhite;
-    d.iq = vsapi->mapGetInt(in, "iq", 0, &err);
+        d->superwhite = 1;
+    d->superwhite = !!d->superwhite;
+    d->iq = vsapi->mapGetInt(in, "iq", 0, &err);
     if (err)
-        d.iq = d.hdr ? IQ_NONE : d.resolution < UHDTV1 ? IQ_BOTH : IQ_NONE;
-    if (d.iq < 0 || d.iq > 3)
-        RETERROR("ColorBars: invalid I/Q mode");
-    d.wcg = vsapi->mapGetIntSaturated(in, "wcg", 0, &err);
+        d->iq = d->hdr ? IQ_NONE : d->resolution < UHDTV1 ? IQ_BOTH : IQ_NONE;
+    if (d->iq < 0 || d->iq > 3)
+        return "ColorBars: invalid I/Q mode";
+    d->wcg = vsapi->mapGetIntSaturated(in, "wcg", 0, &err);
     if (err)
-        d.wcg = 0;
-    d.wcg = !!d.wcg;
-    if (d.wcg && !d.hdr)
+        d->wcg = 0;
+    d->wcg = !!d->wcg;
+    if (d->wcg && !d->hdr)
     {
-        if (d.resolution < UHDTV1 || d.resolution > UHDTV2)
-            RETERROR("ColorBars: wide color (Rec.2020) only valid with UHDTV systems");
-        if (d.iq == IQ_BOTH || d.iq == IQ_PLUS_I)
-            RETERROR("ColorBars: -I/+Q and +I not valid with wide color (Rec.2020)");
+        if (d->resolution < UHDTV1 || d->resolution > UHDTV2)
+            return "ColorBars: wide color (Rec.2020) only valid with UHDTV systems";
+        if (d->iq == IQ_BOTH || d->iq == IQ_PLUS_I)
+            return "ColorBars: -I/+Q and +I not valid with wide color (Rec.2020)";
     }
-    if (d.resolution == UHDTV2)
+    if (d->resolution == UHDTV2)
     {
-        if (!d.wcg && !d.hdr)
+        if (!d->wcg && !d->hdr)
             vsapi->logMessage(mtWarning, "ColorBars: wide color (Rec.2020) required with 8K/UHDTV2", core);
-        if (d.iq == IQ_BOTH || d.iq == IQ_PLUS_I)
+        if (d->iq == IQ_BOTH || d->iq == IQ_PLUS_I)
             vsapi->logMessage(mtWarning, "ColorBars: -I/+Q and +I not valid with 8K/UHDTV2 systems", core);
     }
-    if (d.hdr)
+    if (d->hdr)
     {
-        if (d.resolution < HD1080)
-            RETERROR("ColorBars: HDR mode only valid with 1080 or higher resolutions");
-        if (d.wcg)
+        if (d->resolution < HD1080)
+            return "ColorBars: HDR mode only valid with 1080 or higher resolutions";
+        if (d->wcg)
             vsapi->logMessage(mtWarning, "ColorBars: HDR mode always uses wide color (Rec.2020). Setting wcg=1 has no effect.", core);
-        if (d.iq)
+        if (d->iq)
             vsapi->logMessage(mtWarning, "ColorBars: I/Q is not valid option with HDR", core);
     }
 
-    d.halfline = vsapi->mapGetIntSaturated(in, "halfline", 0, &err);
+    d->halfline = vsapi->mapGetIntSaturated(in, "halfline", 0, &err);
     if (err)
-        d.halfline = 0;
-    d.halfline = !!d.halfline;
-    if (d.halfline && (d.resolution > PAL && d.resolution < NTSC_4FSC))
-        RETERROR("ColorBars: Half line blanking only valid with NTSC/PAL");
+        d->halfline = 0;
+    d->halfline = !!d->halfline;
+    if (d->halfline && (d->resolution > PAL && d->resolution < NTSC_4FSC))
+        return "ColorBars: Half line blanking only valid with NTSC/PAL";
 
-    d.filter = vsapi->mapGetIntSaturated(in, "filter", 0, &err);
+    d->scan = vsapi->mapGetIntSaturated(in, "scan", 0, &err);
     if (err)
-        d.filter = 1;
-    d.filter = !!d.filter;
+        d->scan = SCAN_PROGRESSIVE;
+    if (d->scan < SCAN_PROGRESSIVE || d->scan > SCAN_FIELDS)
+        return "ColorBars: invalid scan mode";
+    if (d->scan == SCAN_INTERLACED && d->resolution != HD1080 && (d->resolution > PAL && d->resolution < NTSC_4FSC))
+        return "ColorBars: interlaced scan only valid with NTSC, PAL and 1080";
+    if (d->scan != SCAN_PROGRESSIVE && d->vi.height % 2)
+        return "ColorBars: height must be even for interlaced scan and fields";
+    if (d->scan == SCAN_FIELDS && (d->vi.height / 2) % (1 << d->vi.format.subSamplingH))
+        return "ColorBars: field height must be even for 4:2:0";
+    // 525-line systems are bottom field first, everything else (and PsF) top field first
+    d->bff = d->resolution == NTSC || d->resolution == NTSC_4FSC;
 
-    d.vi.fpsNum = resolutions[d.resolution][2];
-    d.vi.fpsDen = resolutions[d.resolution][3];
-    d.vi.numFrames = 1;
+    d->filter = vsapi->mapGetIntSaturated(in, "filter", 0, &err);
+    if (err)
+        d->filter = 1;
+    d->filter = !!d->filter;
 
-    data = (ColorBarsData*)malloc(sizeof(d));
-    *data = d;
+    d->timecode = vsapi->mapGetIntSaturated(in, "timecode", 0, &err);
+    if (err)
+        d->timecode = TIMECODE_NONE;
+    if (d->timecode < TIMECODE_NONE || d->timecode > TIMECODE_FRAMES)
+        return "ColorBars: invalid timecode mode";
 
-    vsapi->createVideoFilter(out, "ColorBars", &d.vi, colorbarsGetFrame, colorbarsFree, fmParallel, NULL, 0, data, core);
+    d->vi.fpsNum = vsapi->mapGetInt(in, "fpsnum", 0, &err);
+    if (err)
+    {
+        if (vsapi->mapNumElements(in, "fpsden") > 0)
+            return "ColorBars: fpsden needs fpsnum";
+        d->vi.fpsNum = resolutions[d->resolution][2];
+        d->vi.fpsDen = resolutions[d->resolution][3];
+    }
+    else
+    {
+        d->vi.fpsDen = vsapi->mapGetInt(in, "fpsden", 0, &err);
+        if (err)
+            d->vi.fpsDen = 1;
+    }
+    if (d->vi.fpsNum < 1 || d->vi.fpsDen < 1)
+        return "ColorBars: invalid frame rate";
+    vsh_reduceRational(&d->vi.fpsNum, &d->vi.fpsDen);
+
+    // every frame is a reference to the same cached frame, so long clips cost nothing extra
+    int64_t length = vsapi->mapGetInt(in, "length", 0, &err);
+    if (err)
+    {
+        // checked as a double, the cast is undefined for NaN and anything out of range
+        const double seconds = vsapi->mapGetFloat(in, "seconds", 0, &err);
+        const double frames = err ? 1.0 : seconds * d->vi.fpsNum / d->vi.fpsDen + 0.5;
+        if (!(frames >= 1.0 && frames <= INT_MAX))
+            return "ColorBars: invalid length";
+        length = (int64_t)frames;
+    }
+    else if (vsapi->mapNumElements(in, "seconds") > 0)
+        return "ColorBars: length and seconds are mutually exclusive";
+    if (length < 1 || length > INT_MAX)
+        return "ColorBars: invalid length";
+    d->vi.numFrames = (int)length;
+
+    d->reference = vsapi->mapGetIntSaturated(in, "opt", 0, &err);
+    if (err)
+        d->reference = 0;
+    if (d->reference < 0 || d->reference > 1)
+        return "ColorBars: invalid opt, 0 for the fastest path or 1 for the scalar reference";
+    d->stats = !!vsapi->mapGetIntSaturated(in, "stats", 0, &err);
+    d->prerender = !!vsapi->mapGetIntSaturated(in, "prerender", 0, &err);
+    d->geometry = !!vsapi->mapGetIntSaturated(in, "geometry", 0, &err);
+    d->kernels = colorbars_get_kernels(d->reference);
+    if (d->pattern == PATTERN_BARS)
+        compile_layout(d);
+    if (d->layout)
+    {
+        colorbars_layout_free(d->layout);
+        free(d->layout);
+        d->layout = NULL;
+    }
+
+    // the layout is in frame rows, the clip is in fields
+    if (d->scan == SCAN_FIELDS)
+    {
+        if (d->vi.numFrames > INT_MAX / 2)
+            return "ColorBars: invalid length";
+        if (d->vi.fpsNum > INT64_MAX / 2)
+            return "ColorBars: invalid frame rate";
+        d->vi.height /= 2;
+        d->vi.numFrames *= 2;
+        d->vi.fpsNum *= 2;
+        vsh_reduceRational(&d->vi.fpsNum, &d->vi.fpsDen);
+    }
+
+    // like std.Crop, but only the window is ever rendered
+    d->raster_width = d->vi.width;
+    d->raster_height = d->vi.height;
+    if (d->division)
+    {
+        if (vsapi->mapNumElements(in, "left") > 0 || vsapi->mapNumElements(in, "right") > 0 ||
+            vsapi->mapNumElements(in, "top") > 0 || vsapi->mapNumElements(in, "bottom") > 0)
+            return "ColorBars: sub-images can't be cropped";
+        if (d->scan != SCAN_PROGRESSIVE)
+            return "ColorBars: sub-images need progressive scan";
+        if (d->division == DIVISION_SQUARE)
+        {
+            if (d->vi.width % (2 << d->vi.format.subSamplingW) || d->vi.height % (2 << d->vi.format.subSamplingH))
+                return "ColorBars: quadrants must be multiples of the subsampling";
+            d->left = (d->subimage & 1) * d->vi.width / 2;
+            d->top = (d->subimage >> 1) * d->vi.height / 2;
+        }
+        else
+        {
+            if (d->vi.width % 4 || d->vi.height % 2)
+                return "ColorBars: 2SI needs a width that is a multiple of 4 and an even height";
+            if (d->vi.format.subSamplingW > 1 || d->vi.format.subSamplingH)
+                return "ColorBars: 2SI sub-images need 4:4:4 or 4:2:2";
+        }
+        d->vi.width /= 2;
+        d->vi.height /= 2;
+        if (d->pattern == PATTERN_ZONEPLATE)
+            colorbars_zoneplate_init(d);
+        return NULL;
+    }
+    const int left = vsapi->mapGetIntSaturated(in, "left", 0, &err);
+    const int right = vsapi->mapGetIntSaturated(in, "right", 0, &err);
+    const int top = vsapi->mapGetIntSaturated(in, "top", 0, &err);
+    const int bottom = vsapi->mapGetIntSaturated(in, "bottom", 0, &err);
+    if (left < 0 || right < 0 || top < 0 || bottom < 0 ||
+        (int64_t)left + right >= d->vi.width || (int64_t)top + bottom >= d->vi.height)
+        return "ColorBars: invalid crop";
+    if (left % (1 << d->vi.format.subSamplingW) || right % (1 << d->vi.format.subSamplingW) ||
+        top % (1 << d->vi.format.subSamplingH) || bottom % (1 << d->vi.format.subSamplingH))
+        return "ColorBars: crop must be a multiple of the subsampling";
+    if (d->scan == SCAN_INTERLACED && top % 2)
+        return "ColorBars: top must be even for interlaced scan";
+    d->left = left;
+    d->top = top;
+    d->vi.width -= left + right;
+    d->vi.height -= top + bottom;
+    if (d->pattern == PATTERN_ZONEPLATE)
+        colorbars_zoneplate_init(d);
+    return NULL;
 }
 
+// Takes over the parsed instance
+static VSNode *colorbars_node(const ColorBarsData *d, VSCore *core, const VSAPI *vsapi)
+{
+    ColorBarsData *data = (ColorBarsData*)malloc(sizeof(*d));
+    *data = *d;
+    if (d->pattern == PATTERN_BARS)
+    {
+        colorbars_share(data, core);
+        if (d->prerender)
+            colorbars_prerender(data, core, vsapi);
+    }
+
+    // fmUnordered serializes getFrame calls so the cached frame is only ever rendered once,
+    // zone plate frames are all different and render in parallel
+    return vsapi->createVideoFilter2("ColorBars", &d->vi, colorbarsGetFrame, colorbarsFree,
+                                     d->pattern == PATTERN_ZONEPLATE ? fmParallel : fmUnordered, NULL, 0, data, core);
+}
+
+static void VS_CC colorbarsCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
+{
+    ColorBarsData d = { 0 };
+
+    const char *error = colorbars_parse(&d, in, core, vsapi);
+    if (error)
+    {
+        colorbars_free_layout(&d);
+        RETERROR(error);
+    }
+    vsapi->mapConsumeNode(out, "clip", colorbars_node(&d, core, vsapi), maReplace);
+}
+
+// The four sub-images of a quad-link signal as separate clips, each rendered straight from the layout
+static void VS_CC subimagesCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
+{
+    int err;
+    int division = vsapi->mapGetIntSaturated(in, "division", 0, &err);
+    if (err)
+        division = DIVISION_2SI;
+    if (division < DIVISION_SQUARE || division > DIVISION_2SI)
+        RETERROR("SubImages: invalid division, 1 for square division or 2 for 2SI");
+
+    for (int i = 0; i < 4; i++)
+    {
+        ColorBarsData d = { 0 };
+        d.division = division;
+        d.subimage = i;
+        const char *error = colorbars_parse(&d, in, core, vsapi);
+        if (error)
+        {
+            colorbars_free_layout(&d);
+            RETERROR(error);
+        }
+        vsapi->mapConsumeNode(out, "clip", colorbars_node(&d, core, vsapi), maAppend);
+    }
+}
+
+// arguments shared by every function that renders the pattern
+#define COLORBARS_ARGS \
+    "pattern:int:opt;" \
+    "speed:float:opt;" \
+    "resolution:int:opt;" \
+    "width:int:opt;" \
+    "height:int:opt;" \
+    "format:int:opt;" \
+    "hdr:int:opt;" \
+    "wcg:int:opt;" \
+    "compatability:int:opt;" \
+    "subblack:int:opt;" \
+    "superwhite:int:opt;" \
+    "iq:int:opt;" \
+    "halfline:int:opt;" \
+    "scan:int:opt;" \
+    "filter:int:opt;" \
+    "timecode:int:opt;" \
+    "length:int:opt;" \
+    "seconds:float:opt;" \
+    "fpsnum:int:opt;" \
+    "fpsden:int:opt;" \
+    "opt:int:opt;" \
+    "stats:int:opt;" \
+    "prerender:int:opt;" \
+    "left:int:opt;" \
+    "right:int:opt;" \
+    "top:int:opt;" \
+    "bottom:int:opt;" \
+    "geometry:int:opt;" \
+    "layout:data:opt;"
+
 VS_EXTERNAL_API(void) VapourSynthPluginInit2( VSPlugin* plugin, const VSPLUGINAPI* vspapi)
 {
     vspapi->configPlugin( "com.ifb.colorbars", "colorbars", "SMPTE RP 219-2:2016 and ITU-BT.2111 color bar generator for VapourSynth", VS_MAKE_VERSION(1, 0), VAPOURSYNTH_API_VERSION, 0, plugin );
-    vspapi->registerFunction( "ColorBars",
-                              "resolution:int:opt;"
-                              "format:int:opt;"
-                              "hdr:int:opt;"
-                              "wcg:int:opt;"
-                              "compatability:int:opt;"
-                              "subblack:int:opt;"
-                              "superwhite:int:opt;"
-                              "iq:int:opt;"
-                              "halfline:int:opt;"
-                              "filter:int:opt;",
-                              "clip:vnode;",
-                              colorbarsCreate, NULL, plugin );
+    vspapi->registerFunction( "ColorBars", COLORBARS_ARGS, "clip:vnode;", colorbarsCreate, NULL, plugin );
+    vspapi->registerFunction( "Write", COLORBARS_ARGS "file:data;container:data:opt;", "bytes:int;", writeCreate, NULL, plugin );
+    vspapi->registerFunction( "Tone", COLORBARS_ARGS "samplerate:int:opt;frequency:int:opt;level:float:opt;ident:int:opt;channels:int:opt;bits:int:opt;sampletype:int:opt;", "clip:anode;", toneCreate, NULL, plugin );
+    vspapi->registerFunction( "SubImages", COLORBARS_ARGS "division:int:opt;", "clip:vnode[];", subimagesCreate, NULL, plugin );
+    vspapi->registerFunction( "Verify", "clip:vnode;" COLORBARS_ARGS "margin:int:opt;rows:int:opt;tolerance:float:opt;", "clip:vnode;", verifyCreate, NULL, plugin );
+    vspapi->registerFunction( "Stats", "reset:int:opt;", "renders:int;render_ns:int;bytes:int;cache_hits:int;cache_misses:int;kernel:data;", statsCreate, NULL, plugin );
 }
@@ -0,0 +1,219 @@
+/*****************************************************************************
+ * colorbars: a vapoursynth plugin for generating color bar test patterns
+ *****************************************************************************
+ * VapourSynth plugin
+ *     Copyright (C) 2022 Phillip Blucas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *****************************************************************************/
+#ifndef COLORBARS_H
+#define COLORBARS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <VapourSynth4.h>
+
+#include "kernels.h"
+
+typedef enum {
+    NTSC = 0,
+    PAL,
+    HD720,
+    HD1080,
+    DCI2K,
+    UHDTV1,
+    DCI4K,
+    UHDTV2,
+    NTSC_4FSC,
+    PAL_4FSC
+} system_type_e;
+
+typedef enum {
+    IQ_NONE = 0,
+    IQ_BOTH,
+    IQ_PLUS_I,
+    IQ_WHITE
+} iq_mode_e;
+
+typedef enum {
+    SCAN_PROGRESSIVE = 0,
+    SCAN_INTERLACED, // woven frames tagged with their field order
+    SCAN_FIELDS      // separate fields (or PsF segments) at twice the frame rate
+} scan_e;
+
+typedef enum {
+    PATTERN_BARS = 0,
+    PATTERN_ZONEPLATE
+} pattern_e;
+
+typedef enum {
+    DIVISION_NONE = 0,
+    DIVISION_SQUARE, // four quadrants
+    DIVISION_2SI     // two-sample interleave (SMPTE ST 425-5), each sub-image every other pair of samples of every other line
+} division_e;
+
+typedef enum {
+    TIMECODE_NONE = 0,
+    TIMECODE_SMPTE,  // HH:MM:SS:FF, drop frame at 30000/1001 and 60000/1001
+    TIMECODE_FRAMES  // frame number
+} timecode_e;
+
+// A horizontal run of samples in one row.  Flat fills have a slope of zero,
+// ramps are written as (int)(base + i * slope).
+typedef struct {
+    int x;
+    int width;
+    float base;
+    float slope;
+} ColorBarsSpan;
+
+// A run of identical rows, drawn from num_spans spans starting at span.
+typedef struct {
+    int y;
+    int height;
+    int span;
+    int num_spans;
+} ColorBarsBand;
+
+// The compiled layout of one plane
+typedef struct {
+    ColorBarsBand *bands;
+    ColorBarsSpan *spans;
+    int num_bands;
+    int num_spans;
+    int lo; // legal range of integer samples, ramps are clamped to it
+    int hi;
+} ColorBarsPlane;
+
+// One patch of a layout file, flat or a ramp from value to end.  A patch with a height starts a
+// new row of that height.
+typedef struct {
+    int height;
+    int width;
+    float value[3];
+    float end[3];
+} ColorBarsPatch;
+
+// A layout loaded from a file, in place of the built-in patterns
+typedef struct {
+    int width;
+    int height;
+    int bits; // of the code values
+    ColorBarsPatch *patches;
+    int num_patches;
+    uint64_t hash; // of the file, for the cache key
+} ColorBarsLayoutFile;
+
+// Rendered bars shared by every instance with the same output on one core
+typedef struct ColorBarsShared ColorBarsShared;
+// A thread rendering the shared bars ahead of the first request
+typedef struct ColorBarsPrerender ColorBarsPrerender;
+
+typedef struct {
+    VSVideoInfo vi;
+    pattern_e pattern;
+    system_type_e resolution;
+    int scaled; // width or height differ from the system's raster, the bar geometry is computed
+    ColorBarsLayoutFile *layout; // loaded from a file, only until the layout is compiled
+    uint64_t layout_hash;
+    int raster_width; // the raster the pattern is laid out on, in clip rows.  The clip is the window
+    int raster_height; // of it starting at left, top.
+    int left;
+    int top;
+    division_e division; // set with subimage (0 to 3) before parsing, for one quad-link sub-image
+    int subimage;
+    int hdr;
+    int wcg;
+    int compatability;
+    int subblack;
+    int superwhite;
+    iq_mode_e iq;
+    int halfline;
+    int filter;
+    int reference; // scalar kernels on a single thread, to check the optimized paths against
+    int stats; // attach render timings to the frames
+    int geometry; // attach the rectangle and values of every patch to the frames
+    timecode_e timecode;
+    scan_e scan;
+    int bff; // bottom field first
+    ColorBarsPlane planes[2][3]; // the frame, or the top and bottom fields
+    const VSFrame *frame[2]; // rendered on first request, then shared
+    ColorBarsShared *shared;
+    int prerender; // start rendering when the filter is created
+    ColorBarsPrerender *prerender_thread;
+    float speed; // zone plate phase advance per frame or field, in turns
+    float *zone; // zone plate phase of each column, in turns
+    const ColorBarsKernels *kernels;
+    char error[192]; // parse errors that need formatting
+} ColorBarsData;
+
+// Parses the ColorBars arguments shared by every function in the plugin and compiles the layout.
+// Returns an error message, or NULL on success.
+const char *colorbars_parse(ColorBarsData *d, const VSMap *in, VSCore *core, const VSAPI *vsapi);
+// Renders the frame, or one field (0 top, 1 bottom), into a new frame with all of its properties set
+VSFrame *colorbars_render(const ColorBarsData *d, int field, VSCore *core, const VSAPI *vsapi);
+void colorbars_free_layout(ColorBarsData *d);
+// Black, white and neutral chroma sample values, full range for full range PQ and float
+void colorbars_levels(const ColorBarsData *d, float *black, float *white, float *neutral);
+// The raster column of sample x of a clip row (4:4:4), and the raster row of row y of the clip
+int colorbars_raster_x(const ColorBarsData *d, int x);
+int colorbars_raster_y(const ColorBarsData *d, int y);
+// Draws the rows of one band of a plane, unshaped, into a row as wide as the raster
+void colorbars_draw_band(const ColorBarsData *d, const ColorBarsPlane *plane, int band, uint8_t *row);
+// Sets the color, range, field and duration properties of a rendered frame
+void colorbars_set_props(const ColorBarsData *d, int field, VSMap *props, const VSAPI *vsapi);
+
+// Joins the cache entry of every instance with the same output on this core, creating it if needed
+void colorbars_share(ColorBarsData *d, VSCore *core);
+// Leaves it, freeing the entry and its frames with the last instance
+void colorbars_unshare(ColorBarsData *d, const VSAPI *vsapi);
+// A new reference to the shared frame, or field, rendered by whichever instance asks first
+const VSFrame *colorbars_shared_frame(const ColorBarsData *d, int field, VSCore *core, const VSAPI *vsapi);
+// Renders the shared frame, or both fields, on a background thread.  Requests made meanwhile wait
+// for it instead of rendering again.
+void colorbars_prerender(ColorBarsData *d, VSCore *core, const VSAPI *vsapi);
+// Waits for the prerender thread, if any, to finish
+void colorbars_prerender_join(ColorBarsData *d);
+
+// Monotonic clock in nanoseconds
+int64_t colorbars_clock_ns(void);
+// Adds a render to the process wide counters returned by colorbars.Stats()
+void colorbars_count_render(int64_t ns, int64_t bytes);
+// Sets the render time, size and kernel properties of a frame rendered with stats
+void colorbars_set_stats(const ColorBarsData *d, VSMap *props, int64_t ns, int64_t bytes, const VSAPI *vsapi);
+// Counts a request for the rendered bars that was served from the cache, or had to render
+void colorbars_count_lookup(int hit);
+
+// Maps and parses a layout file.  Returns an error message written to error, or NULL on success.
+const char *colorbars_layout_load(ColorBarsLayoutFile *layout, const char *path, char *error, size_t size);
+void colorbars_layout_free(ColorBarsLayoutFile *layout);
+
+// Burns the timecode or frame counter of frame (or field) n into a writable frame.  Only the rows
+// under the counter are touched.
+void colorbars_draw_counter(const ColorBarsData *d, VSFrame *frame, int n, const VSAPI *vsapi);
+
+// Builds the per-column phase table of the zone plate
+void colorbars_zoneplate_init(ColorBarsData *d);
+// Renders frame (or field) n of the zone plate.  Only reads d, so it is safe from any thread.
+VSFrame *colorbars_zoneplate_render(const ColorBarsData *d, int n, VSCore *core, const VSAPI *vsapi);
+
+void VS_CC writeCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi);
+void VS_CC statsCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi);
+void VS_CC verifyCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi);
+void VS_CC toneCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi);
+
+#endif
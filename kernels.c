@@ -0,0 +1,617 @@
+/*****************************************************************************
+ * colorbars: a vapoursynth plugin for generating color bar test patterns
+ *****************************************************************************
+ * VapourSynth plugin
+ *     Copyright (C) 2022 Phillip Blucas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *****************************************************************************/
+#include <string.h>
+
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CB_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#define CB_NEON 1
+#include <arm_neon.h>
+#endif
+
+// The ramps are computed in single precision exactly like the scalar expression
+// (int)(base + i * slope).  Build with -ffp-contract=off so no FMA sneaks in.
+
+static void fill_c(uint16_t *dst, int n, uint16_t value)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = value;
+}
+
+static void ramp_c(uint16_t *dst, int n, float base, float slope)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = (int)(base + i * slope);
+}
+
+// 8-bit and float samples are plain loops the compiler vectorizes on its own.
+// They only run when the pattern is first rendered.
+static void fill_u8_c(uint8_t *dst, int n, uint8_t value)
+{
+    memset(dst, value, n);
+}
+
+static void ramp_u8_c(uint8_t *dst, int n, float base, float slope)
+{
+    for (int i = 0; i < n; i++)
+    {
+        int v = (int)(base + i * slope);
+        dst[i] = v < 0 ? 0 : v > 255 ? 255 : v;
+    }
+}
+
+static void fill_f32_c(float *dst, int n, float value)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = value;
+}
+
+static void ramp_f32_c(float *dst, int n, float base, float slope)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = base + i * slope;
+}
+
+// sin(2 pi x): reduce to the nearest whole turn by truncating x + 0.5 (or - 0.5), fold the outer
+// quarters onto the inner ones, then evaluate the odd Taylor polynomial to x^11, good to 2e-7.
+// The amplitude is folded into the coefficients, so the last step is a single multiply-add that
+// -ffast-math has nothing to reassociate in.  The vector versions follow the same operations in
+// the same order.
+#define SIN_C1   6.283185307e+00f
+#define SIN_C3  -4.134170224e+01f
+#define SIN_C5   8.160524928e+01f
+#define SIN_C7  -7.670585975e+01f
+#define SIN_C9   4.205869394e+01f
+#define SIN_C11 -1.509464258e+01f
+
+static void sine_coefs(float c[6], float amp)
+{
+    c[0] = SIN_C1 * amp;
+    c[1] = SIN_C3 * amp;
+    c[2] = SIN_C5 * amp;
+    c[3] = SIN_C7 * amp;
+    c[4] = SIN_C9 * amp;
+    c[5] = SIN_C11 * amp;
+}
+
+// amp * sin(2 pi x), with c from sine_coefs
+static float sin2pi_c(float x, const float *c)
+{
+    x = x - (float)(int)(x + (x < 0.0f ? -0.5f : 0.5f));
+    const float half = x < 0.0f ? -0.5f : 0.5f;
+    if ((x < 0.0f ? -x : x) > 0.25f)
+        x = half - x;
+    const float x2 = x * x;
+    float p = c[5];
+    p = p * x2 + c[4];
+    p = p * x2 + c[3];
+    p = p * x2 + c[2];
+    p = p * x2 + c[1];
+    p = p * x2 + c[0];
+    return p * x;
+}
+
+static void sine_c(float *dst, const float *phase, int n, float shift, float offset, float amp)
+{
+    float c[6];
+    sine_coefs(c, amp);
+    for (int i = 0; i < n; i++)
+        dst[i] = offset + sin2pi_c(phase[i] + shift, c);
+}
+
+static void stat_add(ColorBarsStat *acc, uint64_t sum, uint64_t sq, int max, int n)
+{
+    acc->sum += (double)sum;
+    acc->sq += (double)sq;
+    acc->max = max > acc->max ? max : acc->max;
+    acc->n += n;
+}
+
+static void stat_c(const uint16_t *src, const uint16_t *ref, int n, ColorBarsStat *acc)
+{
+    uint64_t sum = 0;
+    uint64_t sq = 0;
+    int max = 0;
+    for (int i = 0; i < n; i++)
+    {
+        const int d = src[i] > ref[i] ? src[i] - ref[i] : ref[i] - src[i];
+        sum += src[i];
+        sq += (uint64_t)((uint32_t)d * (uint32_t)d);
+        max = d > max ? d : max;
+    }
+    stat_add(acc, sum, sq, max, n);
+}
+
+static void stat_u8_c(const uint8_t *src, const uint8_t *ref, int n, ColorBarsStat *acc)
+{
+    uint64_t sum = 0;
+    uint64_t sq = 0;
+    int max = 0;
+    for (int i = 0; i < n; i++)
+    {
+        const int d = src[i] > ref[i] ? src[i] - ref[i] : ref[i] - src[i];
+        sum += src[i];
+        sq += d * d;
+        max = d > max ? d : max;
+    }
+    stat_add(acc, sum, sq, max, n);
+}
+
+static void stat_f32_c(const float *src, const float *ref, int n, ColorBarsStat *acc)
+{
+    double sum = 0.0;
+    double sq = 0.0;
+    double max = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+        const double d = (double)src[i] - ref[i];
+        sum += src[i];
+        sq += d * d;
+        max = d > max ? d : -d > max ? -d : max;
+    }
+    acc->sum += sum;
+    acc->sq += sq;
+    acc->max = max > acc->max ? max : acc->max;
+    acc->n += n;
+}
+
+#ifdef CB_X86
+__attribute__((target("sse2")))
+static void fill_sse2(uint16_t *dst, int n, uint16_t value)
+{
+    const __m128i v = _mm_set1_epi16((short)value);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    for (; i < n; i++)
+        dst[i] = value;
+}
+
+__attribute__((target("sse2")))
+static void ramp_sse2(uint16_t *dst, int n, float base, float slope)
+{
+    const __m128 b = _mm_set1_ps(base);
+    const __m128 s = _mm_set1_ps(slope);
+    const __m128 step = _mm_set1_ps(8.0f);
+    const __m128i bias = _mm_set1_epi32(32768);
+    const __m128i unbias = _mm_set1_epi16((short)0x8000);
+    __m128 i0 = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 i1 = _mm_setr_ps(4.0f, 5.0f, 6.0f, 7.0f);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i lo = _mm_cvttps_epi32(_mm_add_ps(b, _mm_mul_ps(i0, s)));
+        __m128i hi = _mm_cvttps_epi32(_mm_add_ps(b, _mm_mul_ps(i1, s)));
+        // SSE2 only has a signed 32->16 pack, so shift the range down and back up
+        __m128i packed = _mm_packs_epi32(_mm_sub_epi32(lo, bias), _mm_sub_epi32(hi, bias));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(packed, unbias));
+        i0 = _mm_add_ps(i0, step);
+        i1 = _mm_add_ps(i1, step);
+    }
+    for (; i < n; i++)
+        dst[i] = (int)(base + i * slope);
+}
+
+__attribute__((target("sse2")))
+static void sine_sse2(float *dst, const float *phase, int n, float shift, float offset, float amp)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    const __m128 sh = _mm_set1_ps(shift);
+    const __m128 o = _mm_set1_ps(offset);
+    float c[6];
+    sine_coefs(c, amp);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 x = _mm_add_ps(_mm_loadu_ps(phase + i), sh);
+        __m128 h = _mm_or_ps(_mm_and_ps(x, sign), half);
+        x = _mm_sub_ps(x, _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(x, h))));
+        h = _mm_or_ps(_mm_and_ps(x, sign), half);
+        __m128 fold = _mm_cmpgt_ps(_mm_andnot_ps(sign, x), quarter);
+        x = _mm_or_ps(_mm_and_ps(fold, _mm_sub_ps(h, x)), _mm_andnot_ps(fold, x));
+        const __m128 x2 = _mm_mul_ps(x, x);
+        __m128 p = _mm_set1_ps(c[5]);
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(c[4]));
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(c[3]));
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(c[2]));
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(c[1]));
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(c[0]));
+        _mm_storeu_ps(dst + i, _mm_add_ps(o, _mm_mul_ps(p, x)));
+    }
+    for (; i < n; i++)
+        dst[i] = offset + sin2pi_c(phase[i] + shift, c);
+}
+
+// |src - ref| from two saturating subtractions, squared into 32-bit products that are widened to
+// 64 bits before they are summed.  Each 32-bit lane of the sample sum takes at most n / 4 samples.
+__attribute__((target("sse2")))
+static void stat_sse2(const uint16_t *src, const uint16_t *ref, int n, ColorBarsStat *acc)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16((short)0x8000);
+    __m128i sum = zero;
+    __m128i sq = zero;
+    __m128i max = bias; // SSE2 only has a signed 16-bit max, so the differences are biased
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+        const __m128i b = _mm_loadu_si128((const __m128i *)(ref + i));
+        const __m128i d = _mm_or_si128(_mm_subs_epu16(a, b), _mm_subs_epu16(b, a));
+        max = _mm_max_epi16(max, _mm_xor_si128(d, bias));
+        sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_unpacklo_epi16(a, zero), _mm_unpackhi_epi16(a, zero)));
+        const __m128i lo = _mm_mullo_epi16(d, d);
+        const __m128i hi = _mm_mulhi_epu16(d, d);
+        const __m128i p0 = _mm_unpacklo_epi16(lo, hi);
+        const __m128i p1 = _mm_unpackhi_epi16(lo, hi);
+        sq = _mm_add_epi64(sq, _mm_add_epi64(_mm_unpacklo_epi32(p0, zero), _mm_unpackhi_epi32(p0, zero)));
+        sq = _mm_add_epi64(sq, _mm_add_epi64(_mm_unpacklo_epi32(p1, zero), _mm_unpackhi_epi32(p1, zero)));
+    }
+    uint32_t s[4];
+    uint64_t q[2];
+    uint16_t m[8];
+    _mm_storeu_si128((__m128i *)s, sum);
+    _mm_storeu_si128((__m128i *)q, sq);
+    _mm_storeu_si128((__m128i *)m, _mm_xor_si128(max, bias));
+    uint64_t total = (uint64_t)s[0] + s[1] + s[2] + s[3];
+    uint64_t squares = q[0] + q[1];
+    int dmax = 0;
+    for (int k = 0; k < 8; k++)
+        dmax = m[k] > dmax ? m[k] : dmax;
+    stat_add(acc, total, squares, dmax, i);
+    stat_c(src + i, ref + i, n - i, acc);
+}
+
+__attribute__((target("avx2")))
+static void fill_avx2(uint16_t *dst, int n, uint16_t value)
+{
+    const __m256i v = _mm256_set1_epi16((short)value);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    if (i + 8 <= n)
+    {
+        _mm_storeu_si128((__m128i *)(dst + i), _mm256_castsi256_si128(v));
+        i += 8;
+    }
+    for (; i < n; i++)
+        dst[i] = value;
+}
+
+__attribute__((target("avx2")))
+static void ramp_avx2(uint16_t *dst, int n, float base, float slope)
+{
+    const __m256 b = _mm256_set1_ps(base);
+    const __m256 s = _mm256_set1_ps(slope);
+    const __m256 step = _mm256_set1_ps(16.0f);
+    __m256 i0 = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 i1 = _mm256_add_ps(i0, _mm256_set1_ps(8.0f));
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i lo = _mm256_cvttps_epi32(_mm256_add_ps(b, _mm256_mul_ps(i0, s)));
+        __m256i hi = _mm256_cvttps_epi32(_mm256_add_ps(b, _mm256_mul_ps(i1, s)));
+        // packus works within 128-bit lanes, put the quadwords back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8);
+        _mm256_storeu_si256((__m256i *)(dst + i), packed);
+        i0 = _mm256_add_ps(i0, step);
+        i1 = _mm256_add_ps(i1, step);
+    }
+    for (; i < n; i++)
+        dst[i] = (int)(base + i * slope);
+}
+
+__attribute__((target("avx2")))
+static void sine_avx2(float *dst, const float *phase, int n, float shift, float offset, float amp)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    const __m256 sh = _mm256_set1_ps(shift);
+    const __m256 o = _mm256_set1_ps(offset);
+    float c[6];
+    sine_coefs(c, amp);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 x = _mm256_add_ps(_mm256_loadu_ps(phase + i), sh);
+        __m256 h = _mm256_or_ps(_mm256_and_ps(x, sign), half);
+        x = _mm256_sub_ps(x, _mm256_cvtepi32_ps(_mm256_cvttps_epi32(_mm256_add_ps(x, h))));
+        h = _mm256_or_ps(_mm256_and_ps(x, sign), half);
+        __m256 fold = _mm256_cmp_ps(_mm256_andnot_ps(sign, x), quarter, _CMP_GT_OQ);
+        x = _mm256_blendv_ps(x, _mm256_sub_ps(h, x), fold);
+        const __m256 x2 = _mm256_mul_ps(x, x);
+        __m256 p = _mm256_set1_ps(c[5]);
+        p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(c[4]));
+        p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(c[3]));
+        p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(c[2]));
+        p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(c[1]));
+        p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(c[0]));
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(o, _mm256_mul_ps(p, x)));
+    }
+    for (; i < n; i++)
+        dst[i] = offset + sin2pi_c(phase[i] + shift, c);
+}
+
+__attribute__((target("avx2")))
+static void stat_avx2(const uint16_t *src, const uint16_t *ref, int n, ColorBarsStat *acc)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sum = zero;
+    __m256i sq = zero;
+    __m256i max = zero;
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+        const __m256i b = _mm256_loadu_si256((const __m256i *)(ref + i));
+        const __m256i d = _mm256_sub_epi16(_mm256_max_epu16(a, b), _mm256_min_epu16(a, b));
+        max = _mm256_max_epu16(max, d);
+        sum = _mm256_add_epi32(sum, _mm256_add_epi32(_mm256_unpacklo_epi16(a, zero), _mm256_unpackhi_epi16(a, zero)));
+        const __m256i lo = _mm256_mullo_epi16(d, d);
+        const __m256i hi = _mm256_mulhi_epu16(d, d);
+        const __m256i p0 = _mm256_unpacklo_epi16(lo, hi);
+        const __m256i p1 = _mm256_unpackhi_epi16(lo, hi);
+        sq = _mm256_add_epi64(sq, _mm256_add_epi64(_mm256_unpacklo_epi32(p0, zero), _mm256_unpackhi_epi32(p0, zero)));
+        sq = _mm256_add_epi64(sq, _mm256_add_epi64(_mm256_unpacklo_epi32(p1, zero), _mm256_unpackhi_epi32(p1, zero)));
+    }
+    uint32_t s[8];
+    uint64_t q[4];
+    uint16_t m[16];
+    _mm256_storeu_si256((__m256i *)s, sum);
+    _mm256_storeu_si256((__m256i *)q, sq);
+    _mm256_storeu_si256((__m256i *)m, max);
+    uint64_t total = 0;
+    for (int k = 0; k < 8; k++)
+        total += s[k];
+    int dmax = 0;
+    for (int k = 0; k < 16; k++)
+        dmax = m[k] > dmax ? m[k] : dmax;
+    stat_add(acc, total, q[0] + q[1] + q[2] + q[3], dmax, i);
+    stat_c(src + i, ref + i, n - i, acc);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void fill_avx512(uint16_t *dst, int n, uint16_t value)
+{
+    const __m512i v = _mm512_set1_epi16((short)value);
+    int i = 0;
+    for (; i + 32 <= n; i += 32)
+        _mm512_storeu_si512((void *)(dst + i), v);
+    if (i < n)
+        _mm512_mask_storeu_epi16(dst + i, (__mmask32)((1ULL << (n - i)) - 1), v);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void ramp_avx512(uint16_t *dst, int n, float base, float slope)
+{
+    const __m512 b = _mm512_set1_ps(base);
+    const __m512 s = _mm512_set1_ps(slope);
+    const __m512 step = _mm512_set1_ps(16.0f);
+    __m512 idx = _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+                                8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m512i r = _mm512_cvttps_epi32(_mm512_add_ps(b, _mm512_mul_ps(idx, s)));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm512_cvtepi32_epi16(r));
+        idx = _mm512_add_ps(idx, step);
+    }
+    for (; i < n; i++)
+        dst[i] = (int)(base + i * slope);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void sine_avx512(float *dst, const float *phase, int n, float shift, float offset, float amp)
+{
+    const __m512i sign = _mm512_set1_epi32((int)0x80000000);
+    const __m512i half = _mm512_castps_si512(_mm512_set1_ps(0.5f));
+    const __m512 quarter = _mm512_set1_ps(0.25f);
+    const __m512 sh = _mm512_set1_ps(shift);
+    const __m512 o = _mm512_set1_ps(offset);
+    float c[6];
+    sine_coefs(c, amp);
+    int i = 0;
+    while (i < n)
+    {
+        // the tail is a masked pass instead of a scalar loop
+        const __mmask16 m = n - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1U << (n - i)) - 1);
+        __m512 x = _mm512_add_ps(_mm512_maskz_loadu_ps(m, phase + i), sh);
+        __m512 h = _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(_mm512_castps_si512(x), sign), half));
+        x = _mm512_sub_ps(x, _mm512_cvtepi32_ps(_mm512_cvttps_epi32(_mm512_add_ps(x, h))));
+        h = _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(_mm512_castps_si512(x), sign), half));
+        const __mmask16 fold = _mm512_cmp_ps_mask(_mm512_abs_ps(x), quarter, _CMP_GT_OQ);
+        x = _mm512_mask_sub_ps(x, fold, h, x);
+        const __m512 x2 = _mm512_mul_ps(x, x);
+        __m512 p = _mm512_set1_ps(c[5]);
+        p = _mm512_add_ps(_mm512_mul_ps(p, x2), _mm512_set1_ps(c[4]));
+        p = _mm512_add_ps(_mm512_mul_ps(p, x2), _mm512_set1_ps(c[3]));
+        p = _mm512_add_ps(_mm512_mul_ps(p, x2), _mm512_set1_ps(c[2]));
+        p = _mm512_add_ps(_mm512_mul_ps(p, x2), _mm512_set1_ps(c[1]));
+        p = _mm512_add_ps(_mm512_mul_ps(p, x2), _mm512_set1_ps(c[0]));
+        _mm512_mask_storeu_ps(dst + i, m, _mm512_add_ps(o, _mm512_mul_ps(p, x)));
+        i += 16;
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void stat_avx512(const uint16_t *src, const uint16_t *ref, int n, ColorBarsStat *acc)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i sum = zero;
+    __m512i sq = zero;
+    __m512i max = zero;
+    for (int i = 0; i < n; i += 32)
+    {
+        // masked off samples load as zero on both sides and add nothing
+        const __mmask32 k = n - i >= 32 ? (__mmask32)0xFFFFFFFF : (__mmask32)((1ULL << (n - i)) - 1);
+        const __m512i a = _mm512_maskz_loadu_epi16(k, src + i);
+        const __m512i b = _mm512_maskz_loadu_epi16(k, ref + i);
+        const __m512i d = _mm512_sub_epi16(_mm512_max_epu16(a, b), _mm512_min_epu16(a, b));
+        max = _mm512_max_epu16(max, d);
+        sum = _mm512_add_epi32(sum, _mm512_add_epi32(_mm512_unpacklo_epi16(a, zero), _mm512_unpackhi_epi16(a, zero)));
+        const __m512i lo = _mm512_mullo_epi16(d, d);
+        const __m512i hi = _mm512_mulhi_epu16(d, d);
+        const __m512i p0 = _mm512_unpacklo_epi16(lo, hi);
+        const __m512i p1 = _mm512_unpackhi_epi16(lo, hi);
+        sq = _mm512_add_epi64(sq, _mm512_add_epi64(_mm512_unpacklo_epi32(p0, zero), _mm512_unpackhi_epi32(p0, zero)));
+        sq = _mm512_add_epi64(sq, _mm512_add_epi64(_mm512_unpacklo_epi32(p1, zero), _mm512_unpackhi_epi32(p1, zero)));
+    }
+    uint16_t m[32];
+    _mm512_storeu_si512((void *)m, max);
+    int dmax = 0;
+    for (int k = 0; k < 32; k++)
+        dmax = m[k] > dmax ? m[k] : dmax;
+    stat_add(acc, (uint32_t)_mm512_reduce_add_epi32(sum), (uint64_t)_mm512_reduce_add_epi64(sq), dmax, n);
+}
+#endif
+
+#ifdef CB_NEON
+static void fill_neon(uint16_t *dst, int n, uint16_t value)
+{
+    const uint16x8_t v = vdupq_n_u16(value);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+        vst1q_u16(dst + i, v);
+    for (; i < n; i++)
+        dst[i] = value;
+}
+
+static void ramp_neon(uint16_t *dst, int n, float base, float slope)
+{
+    const float32x4_t b = vdupq_n_f32(base);
+    const float32x4_t s = vdupq_n_f32(slope);
+    const float32x4_t step = vdupq_n_f32(8.0f);
+    const float lanes[8] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+    float32x4_t i0 = vld1q_f32(lanes);
+    float32x4_t i1 = vld1q_f32(lanes + 4);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        // separate multiply and add, vmlaq may be fused
+        int32x4_t lo = vcvtq_s32_f32(vaddq_f32(b, vmulq_f32(i0, s)));
+        int32x4_t hi = vcvtq_s32_f32(vaddq_f32(b, vmulq_f32(i1, s)));
+        vst1q_u16(dst + i, vcombine_u16(vqmovun_s32(lo), vqmovun_s32(hi)));
+        i0 = vaddq_f32(i0, step);
+        i1 = vaddq_f32(i1, step);
+    }
+    for (; i < n; i++)
+        dst[i] = (int)(base + i * slope);
+}
+
+static void sine_neon(float *dst, const float *phase, int n, float shift, float offset, float amp)
+{
+    const uint32x4_t sign = vdupq_n_u32(0x80000000);
+    const uint32x4_t half = vreinterpretq_u32_f32(vdupq_n_f32(0.5f));
+    const float32x4_t quarter = vdupq_n_f32(0.25f);
+    const float32x4_t sh = vdupq_n_f32(shift);
+    const float32x4_t o = vdupq_n_f32(offset);
+    float c[6];
+    sine_coefs(c, amp);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        float32x4_t x = vaddq_f32(vld1q_f32(phase + i), sh);
+        float32x4_t h = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(x), sign), half));
+        x = vsubq_f32(x, vcvtq_f32_s32(vcvtq_s32_f32(vaddq_f32(x, h))));
+        h = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(x), sign), half));
+        x = vbslq_f32(vcgtq_f32(vabsq_f32(x), quarter), vsubq_f32(h, x), x);
+        // separate multiply and add again
+        const float32x4_t x2 = vmulq_f32(x, x);
+        float32x4_t p = vdupq_n_f32(c[5]);
+        p = vaddq_f32(vmulq_f32(p, x2), vdupq_n_f32(c[4]));
+        p = vaddq_f32(vmulq_f32(p, x2), vdupq_n_f32(c[3]));
+        p = vaddq_f32(vmulq_f32(p, x2), vdupq_n_f32(c[2]));
+        p = vaddq_f32(vmulq_f32(p, x2), vdupq_n_f32(c[1]));
+        p = vaddq_f32(vmulq_f32(p, x2), vdupq_n_f32(c[0]));
+        vst1q_f32(dst + i, vaddq_f32(o, vmulq_f32(p, x)));
+    }
+    for (; i < n; i++)
+        dst[i] = offset + sin2pi_c(phase[i] + shift, c);
+}
+
+static void stat_neon(const uint16_t *src, const uint16_t *ref, int n, ColorBarsStat *acc)
+{
+    uint32x4_t sum = vdupq_n_u32(0);
+    uint64x2_t sq = vdupq_n_u64(0);
+    uint16x8_t max = vdupq_n_u16(0);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const uint16x8_t a = vld1q_u16(src + i);
+        const uint16x8_t d = vabdq_u16(a, vld1q_u16(ref + i));
+        max = vmaxq_u16(max, d);
+        sum = vpadalq_u16(sum, a);
+        sq = vpadalq_u32(sq, vmull_u16(vget_low_u16(d), vget_low_u16(d)));
+        sq = vpadalq_u32(sq, vmull_u16(vget_high_u16(d), vget_high_u16(d)));
+    }
+    uint32_t s[4];
+    uint64_t q[2];
+    uint16_t m[8];
+    vst1q_u32(s, sum);
+    vst1q_u64(q, sq);
+    vst1q_u16(m, max);
+    int dmax = 0;
+    for (int k = 0; k < 8; k++)
+        dmax = m[k] > dmax ? m[k] : dmax;
+    stat_add(acc, (uint64_t)s[0] + s[1] + s[2] + s[3], q[0] + q[1], dmax, i);
+    stat_c(src + i, ref + i, n - i, acc);
+}
+#endif
+
+static const ColorBarsKernels kernels_c = { "c", fill_c, ramp_c, fill_u8_c, ramp_u8_c, fill_f32_c, ramp_f32_c, sine_c,
+                                                 stat_c, stat_u8_c, stat_f32_c };
+#ifdef CB_X86
+static const ColorBarsKernels kernels_sse2 = { "sse2", fill_sse2, ramp_sse2, fill_u8_c, ramp_u8_c, fill_f32_c, ramp_f32_c, sine_sse2,
+                                                 stat_sse2, stat_u8_c, stat_f32_c };
+static const ColorBarsKernels kernels_avx2 = { "avx2", fill_avx2, ramp_avx2, fill_u8_c, ramp_u8_c, fill_f32_c, ramp_f32_c, sine_avx2,
+                                                 stat_avx2, stat_u8_c, stat_f32_c };
+static const ColorBarsKernels kernels_avx512 = { "avx512", fill_avx512, ramp_avx512, fill_u8_c, ramp_u8_c, fill_f32_c, ramp_f32_c, sine_avx512,
+                                                 stat_avx512, stat_u8_c, stat_f32_c };
+#endif
+#ifdef CB_NEON
+static const ColorBarsKernels kernels_neon = { "neon", fill_neon, ramp_neon, fill_u8_c, ramp_u8_c, fill_f32_c, ramp_f32_c, sine_neon,
+                                                 stat_neon, stat_u8_c, stat_f32_c };
+#endif
+
+const ColorBarsKernels *colorbars_get_kernels(int reference)
+{
+    if (reference)
+        return &kernels_c;
+#ifdef CB_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+        return &kernels_avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return &kernels_avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return &kernels_sse2;
+#elif defined(CB_NEON)
+    return &kernels_neon;
+#endif
+    return &kernels_c;
+}
@@ -0,0 +1,60 @@
+/*****************************************************************************
+ * colorbars: a vapoursynth plugin for generating color bar test patterns
+ *****************************************************************************
+ * VapourSynth plugin
+ *     Copyright (C) 2022 Phillip Blucas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *****************************************************************************/
+#ifndef COLORBARS_KERNELS_H
+#define COLORBARS_KERNELS_H
+
+#include <stdint.h>
+
+// Running statistics of samples against the values they should have
+typedef struct {
+    double sum; // of the samples
+    double sq;  // of the squared differences
+    double max; // largest absolute difference
+    int64_t n;
+} ColorBarsStat;
+
+// Span writers used by the renderer, and the measurement used by Verify.  One set is picked at
+// runtime from the CPU features.
+typedef struct {
+    const char *name;
+    // dst[i] = value
+    void (*fill)(uint16_t *dst, int n, uint16_t value);
+    // dst[i] = (int)(base + i * slope), bit-exact with the scalar expression
+    void (*ramp)(uint16_t *dst, int n, float base, float slope);
+    // the same for 8-bit and float samples, 8-bit ramps saturate and float ramps are not truncated
+    void (*fill_u8)(uint8_t *dst, int n, uint8_t value);
+    void (*ramp_u8)(uint8_t *dst, int n, float base, float slope);
+    void (*fill_f32)(float *dst, int n, float value);
+    void (*ramp_f32)(float *dst, int n, float base, float slope);
+    // dst[i] = offset + amp * sin(2 pi (phase[i] + shift)), the same bits from every set
+    void (*sine)(float *dst, const float *phase, int n, float shift, float offset, float amp);
+    // adds src[i] against ref[i] to acc, integer samples are summed exactly so every set agrees.
+    // n is at most 65536.
+    void (*stat)(const uint16_t *src, const uint16_t *ref, int n, ColorBarsStat *acc);
+    void (*stat_u8)(const uint8_t *src, const uint8_t *ref, int n, ColorBarsStat *acc);
+    void (*stat_f32)(const float *src, const float *ref, int n, ColorBarsStat *acc);
+} ColorBarsKernels;
+
+// The fastest set the CPU supports, or the plain C set when reference is non-zero
+const ColorBarsKernels *colorbars_get_kernels(int reference);
+
+#endif
@@ -0,0 +1,273 @@
+/*****************************************************************************
+ * colorbars: a vapoursynth plugin for generating color bar test patterns
+ *****************************************************************************
+ * VapourSynth plugin
+ *     Copyright (C) 2022 Phillip Blucas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *****************************************************************************/
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "colorbars.h"
+
+// Layout files describe a pattern in the terms the built-in ones are compiled to: rows of patches,
+// each flat or a ramp.  One statement per line, # starts a comment:
+//
+//     raster <width> <height> <bits>               the raster and the depth of the code values, first
+//     row <height>                                 starts a row of patches
+//     bar <width> <c0> <c1> <c2>                   a flat patch, one code value per plane
+//     ramp <width> <c0> <c1> <c2> <e0> <e1> <e2>   a ramp from the first values to the last ones
+//
+// Patches fill their row from the left and add up to the raster width, rows add up to its height.
+// The file is mapped, not read, and parsed in place, so it isn't terminated: every read checks end.
+
+// Layouts are a few hundred patches, anything much bigger is not a layout file
+#define LAYOUT_MAX_BYTES (16 << 20)
+
+typedef struct {
+    const char *p;
+    const char *end;
+    int line;
+} LayoutReader;
+
+// Skips blanks and a comment, up to the end of the line
+static void skip_blank(LayoutReader *r)
+{
+    while (r->p < r->end && (*r->p == ' ' || *r->p == '\t' || *r->p == '\r'))
+        r->p++;
+    if (r->p < r->end && *r->p == '#')
+        while (r->p < r->end && *r->p != '\n')
+            r->p++;
+}
+
+static int read_word(LayoutReader *r, char *word, int size)
+{
+    skip_blank(r);
+    int n = 0;
+    while (r->p < r->end && *r->p >= 'a' && *r->p <= 'z' && n < size - 1)
+        word[n++] = *r->p++;
+    word[n] = 0;
+    return n > 0 && (r->p == r->end || *r->p == ' ' || *r->p == '\t' || *r->p == '\r' || *r->p == '\n' || *r->p == '#');
+}
+
+// A non-negative decimal of at most 8 digits, which is plenty for sizes and code values
+static int read_int(LayoutReader *r, int *v)
+{
+    skip_blank(r);
+    int n = 0;
+    *v = 0;
+    while (r->p < r->end && *r->p >= '0' && *r->p <= '9' && n < 8)
+    {
+        *v = *v * 10 + (*r->p++ - '0');
+        n++;
+    }
+    return n > 0 && (r->p == r->end || *r->p == ' ' || *r->p == '\t' || *r->p == '\r' || *r->p == '\n' || *r->p == '#');
+}
+
+// Steps to the next line, which has to be all that is left of this one
+static int end_line(LayoutReader *r)
+{
+    skip_blank(r);
+    if (r->p == r->end)
+        return 1;
+    if (*r->p != '\n')
+        return 0;
+    r->p++;
+    r->line++;
+    return 1;
+}
+
+static const char *parse_layout(ColorBarsLayoutFile *layout, LayoutReader *r)
+{
+    int size = 0; // allocated patches
+    int x = -1; // cursor in the current row, -1 before the first
+    int y = 0;
+    char word[8];
+    while (r->p < r->end)
+    {
+        skip_blank(r);
+        if (r->p < r->end && *r->p == '\n')
+        {
+            end_line(r);
+            continue;
+        }
+        if (r->p == r->end)
+            break;
+        if (!read_word(r, word, sizeof(word)))
+            return "unknown statement";
+        if (!strcmp(word, "raster"))
+        {
+            if (layout->width)
+                return "raster is given twice";
+            if (!read_int(r, &layout->width) || !read_int(r, &layout->height) || !read_int(r, &layout->bits))
+                return "raster needs a width, a height and a bit depth";
+            if (layout->width < 1 || layout->height < 1 || layout->width > 16384 || layout->height > 16384)
+                return "the raster must be from 1x1 to 16384x16384";
+            if (layout->bits < 8 || layout->bits > 16)
+                return "code values must be 8 to 16 bits";
+        }
+        else if (!layout->width)
+            return "the raster has to come first";
+        else if (!strcmp(word, "row"))
+        {
+            if (x >= 0 && x != layout->width)
+                return "the previous row doesn't add up to the raster width";
+            int height;
+            if (!read_int(r, &height) || height < 1)
+                return "row needs a height";
+            if (height > layout->height - y)
+                return "the rows add up to more than the raster height";
+            x = 0;
+            y += height;
+            // the next patch starts the row
+            if (layout->num_patches == size)
+            {
+                size = size ? size * 2 : 64;
+                layout->patches = (ColorBarsPatch *)realloc(layout->patches, size * sizeof(ColorBarsPatch));
+            }
+            memset(&layout->patches[layout->num_patches], 0, sizeof(ColorBarsPatch));
+            layout->patches[layout->num_patches].height = height;
+        }
+        else if (!strcmp(word, "bar") || !strcmp(word, "ramp"))
+        {
+            const int ramp = word[0] == 'r';
+            if (x < 0)
+                return "patches need a row";
+            int width;
+            int v[6];
+            if (!read_int(r, &width) || width < 1)
+                return "patches need a width";
+            for (int i = 0; i < (ramp ? 6 : 3); i++)
+                if (!read_int(r, &v[i]) || v[i] >= 1 << layout->bits)
+                    return ramp ? "ramp needs six code values within the bit depth" : "bar needs three code values within the bit depth";
+            if (width > layout->width - x)
+                return "the row is wider than the raster";
+            // a row statement left a patch with its height, otherwise this one is new
+            if (layout->num_patches == size)
+            {
+                size = size ? size * 2 : 64;
+                layout->patches = (ColorBarsPatch *)realloc(layout->patches, size * sizeof(ColorBarsPatch));
+            }
+            ColorBarsPatch *patch = &layout->patches[layout->num_patches];
+            if (x > 0)
+                patch->height = 0;
+            patch->width = width;
+            for (int p = 0; p < 3; p++)
+            {
+                patch->value[p] = (float)v[p];
+                patch->end[p] = (float)v[ramp ? p + 3 : p];
+            }
+            layout->num_patches++;
+            x += width;
+        }
+        else
+            return "unknown statement";
+        if (!end_line(r))
+            return "unexpected text at the end of the line";
+    }
+    if (!layout->width)
+        return "no raster";
+    if (x != layout->width)
+        return "the last row doesn't add up to the raster width";
+    if (y != layout->height)
+        return "the rows don't add up to the raster height";
+    return NULL;
+}
+
+const char *colorbars_layout_load(ColorBarsLayoutFile *layout, const char *path, char *error, size_t size)
+{
+    memset(layout, 0, sizeof(*layout));
+    const char *data = NULL;
+    int64_t bytes = 0;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    HANDLE mapping = NULL;
+    LARGE_INTEGER length;
+    if (file != INVALID_HANDLE_VALUE && GetFileSizeEx(file, &length))
+    {
+        bytes = length.QuadPart;
+        if (bytes > 0 && bytes <= LAYOUT_MAX_BYTES && (mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL)))
+            data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    const int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && !fstat(fd, &st))
+    {
+        bytes = st.st_size;
+        if (bytes > 0 && bytes <= LAYOUT_MAX_BYTES)
+        {
+            data = (const char *)mmap(NULL, (size_t)bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == (const char *)MAP_FAILED)
+                data = NULL;
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+#endif
+
+    const char *message = NULL;
+    LayoutReader r = { data, data + bytes, 1 };
+    if (!data)
+        snprintf(error, size, "ColorBars: can't map layout file %s", path);
+    else if ((message = parse_layout(layout, &r)))
+        snprintf(error, size, "ColorBars: layout line %d: %s", r.line, message);
+    else
+    {
+        // FNV-1a of the contents, identical files render identical frames
+        layout->hash = 14695981039346656037ULL;
+        for (int64_t i = 0; i < bytes; i++)
+            layout->hash = (layout->hash ^ (uint8_t)data[i]) * 1099511628211ULL;
+    }
+
+#ifdef _WIN32
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+#else
+    if (data)
+        munmap((void *)data, (size_t)bytes);
+#endif
+    if (!data || message)
+    {
+        colorbars_layout_free(layout);
+        return error;
+    }
+    return NULL;
+}
+
+void colorbars_layout_free(ColorBarsLayoutFile *layout)
+{
+    free(layout->patches);
+    layout->patches = NULL;
+    layout->num_patches = 0;
+}
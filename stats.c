@@ -0,0 +1,90 @@
+/*****************************************************************************
+ * colorbars: a vapoursynth plugin for generating color bar test patterns
+ *****************************************************************************
+ * VapourSynth plugin
+ *     Copyright (C) 2022 Phillip Blucas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *****************************************************************************/
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700
+#endif
+#include <stdint.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <VapourSynth4.h>
+
+#include "colorbars.h"
+
+// Process wide counters, for every instance on every core.  Updated with atomics, renders are
+// rare and lookups of the cached frame are one increment.
+static struct {
+    int64_t renders;
+    int64_t render_ns;
+    int64_t bytes;
+    int64_t hits;
+    int64_t misses;
+} stats;
+
+int64_t colorbars_clock_ns(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER t, f;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    return (int64_t)((double)t.QuadPart * 1e9 / f.QuadPart);
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+#endif
+}
+
+void colorbars_count_render(int64_t ns, int64_t bytes)
+{
+    __atomic_fetch_add(&stats.renders, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats.render_ns, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats.bytes, bytes, __ATOMIC_RELAXED);
+}
+
+void colorbars_count_lookup(int hit)
+{
+    __atomic_fetch_add(hit ? &stats.hits : &stats.misses, 1, __ATOMIC_RELAXED);
+}
+
+void colorbars_set_stats(const ColorBarsData *d, VSMap *props, int64_t ns, int64_t bytes, const VSAPI *vsapi)
+{
+    vsapi->mapSetInt(props, "ColorBarsRenderNs", ns, maReplace);
+    vsapi->mapSetInt(props, "ColorBarsBytes", bytes, maReplace);
+    vsapi->mapSetData(props, "ColorBarsKernel", d->kernels->name, -1, dtUtf8, maReplace);
+}
+
+void VS_CC statsCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
+{
+    int err;
+    const int reset = !!vsapi->mapGetIntSaturated(in, "reset", 0, &err);
+    int64_t *counters[] = { &stats.renders, &stats.render_ns, &stats.bytes, &stats.hits, &stats.misses };
+    const char *names[] = { "renders", "render_ns", "bytes", "cache_hits", "cache_misses" };
+    for (int i = 0; i < 5; i++)
+        vsapi->mapSetInt(out, names[i], reset ? __atomic_exchange_n(counters[i], 0, __ATOMIC_RELAXED)
+                                              : __atomic_load_n(counters[i], __ATOMIC_RELAXED), maReplace);
+    // what this CPU dispatches to, instances with opt=1 use the C kernels instead
+    vsapi->mapSetData(out, "kernel", colorbars_get_kernels(0)->name, -1, dtUtf8, maReplace);
+}
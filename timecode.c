@@ -0,0 +1,211 @@
+/*****************************************************************************
+ * colorbars: a vapoursynth plugin for generating color bar test patterns
+ *****************************************************************************
+ * VapourSynth plugin
+ *     Copyright (C) 2022 Phillip Blucas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <VapourSynth4.h>
+
+#include "colorbars.h"
+
+// 5x7 glyphs, one byte per row, most significant of the five bits on the left
+static const uint8_t font[12][7] = { { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E },   // 0
+                                     { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },   // 1
+                                     { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F },   // 2
+                                     { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },   // 3
+                                     { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 },   // 4
+                                     { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },   // 5
+                                     { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E },   // 6
+                                     { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },   // 7
+                                     { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E },   // 8
+                                     { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },   // 9
+                                     { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 },   // :
+                                     { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08 } }; // ;
+
+// Each character is a 6x9 cell (the glyph plus spacing), the box adds one cell column of padding
+#define CELL_W 6
+#define CELL_H 9
+
+static int glyph_index(char c)
+{
+    return c == ':' ? 10 : c == ';' ? 11 : c - '0';
+}
+
+// Frame rate of whole frames, even when the clip is in fields
+static void frame_rate(const ColorBarsData *d, int64_t *num, int64_t *den)
+{
+    *num = d->vi.fpsNum;
+    *den = d->vi.fpsDen * (d->scan == SCAN_FIELDS ? 2 : 1);
+}
+
+static int counter_chars(const ColorBarsData *d)
+{
+    if (d->timecode == TIMECODE_SMPTE)
+        return 11;
+    char text[16];
+    const int frames = d->scan == SCAN_FIELDS ? d->vi.numFrames / 2 : d->vi.numFrames;
+    return snprintf(text, sizeof(text), "%d", frames - 1);
+}
+
+// HH:MM:SS:FF, or HH:MM:SS;FF with frame numbers dropped at 30000/1001 and 60000/1001
+static void counter_text(const ColorBarsData *d, int frame, char *text, size_t size)
+{
+    if (d->timecode == TIMECODE_FRAMES)
+    {
+        snprintf(text, size, "%0*d", counter_chars(d), frame);
+        return;
+    }
+
+    int64_t num, den;
+    frame_rate(d, &num, &den);
+    const int64_t base = (num + den / 2) / den;
+    const int drop = num * 1001 == base * 1000 * den && base % 30 == 0 ? (int)(base / 15) : 0;
+    int64_t n = frame;
+    if (drop)
+    {
+        // the first drop frame numbers of every minute are skipped, except every tenth minute
+        const int64_t per_ten = base * 600 - drop * 9;
+        const int64_t per_minute = base * 60 - drop;
+        const int64_t tens = n / per_ten;
+        const int64_t rest = n % per_ten;
+        n += drop * 9 * tens + (rest > drop ? drop * ((rest - drop) / per_minute) : 0);
+    }
+    snprintf(text, size, "%02d:%02d:%02d%c%02d", (int)(n / (base * 3600) % 24), (int)(n / (base * 60) % 60),
+             (int)(n / base % 60), drop ? ';' : ':', (int)(n % base));
+}
+
+static void put_sample(uint8_t *row, int i, float v, const VSVideoFormat *f)
+{
+    if (f->sampleType == stFloat)
+        ((float *)row)[i] = v;
+    else if (f->bytesPerSample == 1)
+        row[i] = (uint8_t)v;
+    else
+        ((uint16_t *)row)[i] = (uint16_t)v;
+}
+
+// One line of the box, white glyph pixels on black.  Rows outside the glyphs are plain black.
+static void build_row(uint8_t *row, const char *text, int chars, int gy, int scale, float black, float white,
+                      const VSVideoFormat *f)
+{
+    const int width = (chars * CELL_W + 1) * scale;
+    for (int i = 0; i < width; i++)
+    {
+        const int u = i / scale - 1;
+        const int c = u / CELL_W;
+        const int col = u % CELL_W;
+        const int on = gy >= 0 && gy < 7 && u >= 0 && c < chars && col < 5 && (font[glyph_index(text[c])][gy] & (0x10 >> col));
+        put_sample(row, i, on ? white : black, f);
+    }
+}
+
+void colorbars_draw_counter(const ColorBarsData *d, VSFrame *frame, int n, const VSAPI *vsapi)
+{
+    const VSVideoFormat *f = &d->vi.format;
+    const int fields = d->scan == SCAN_FIELDS;
+    const int field = fields ? (n & 1) ^ d->bff : 0;
+    const int frame_height = fields ? d->raster_height * 2 : d->raster_height;
+    const int chars = counter_chars(d);
+    char text[16];
+    counter_text(d, fields ? n / 2 : n, text, sizeof(text));
+
+    // centered near the top of the raster, in frame rows, kept on multiples of 4 so fields and 4:2:0
+    // chroma line up
+    const int scale = frame_height / 180 > 1 ? frame_height / 180 : 1;
+    const int box_w = ((chars * CELL_W + 1) * scale + 1) & ~1;
+    const int box_h = (CELL_H * scale + 3) & ~3;
+    const int box_x = ((d->raster_width - box_w) / 2) & ~1;
+    const int box_y = (frame_height / 12) & ~3;
+    int y0 = fields ? box_y / 2 : box_y;
+    int y1 = fields ? (box_y + box_h) / 2 : box_y + box_h;
+
+    // the part of it inside the window, even like the window edges of subsampled formats.  A 2SI
+    // sub-image has every other line and pair of samples of all of it.
+    const int tsi = d->division == DIVISION_2SI;
+    int x0 = box_x;
+    int x1 = box_x + box_w;
+    if (tsi)
+    {
+        // clip rows and columns whose raster position is in the box, the mapping keeps the order
+        const int top = y0, bottom = y1;
+        for (x0 = 0; x0 < d->vi.width && colorbars_raster_x(d, x0) < box_x; x0++);
+        for (x1 = x0; x1 < d->vi.width && colorbars_raster_x(d, x1) < box_x + box_w; x1++);
+        for (y0 = 0; y0 < d->vi.height && colorbars_raster_y(d, y0) < top; y0++);
+        for (y1 = y0; y1 < d->vi.height && colorbars_raster_y(d, y1) < bottom; y1++);
+    }
+    else
+    {
+        x0 = x0 > d->left ? x0 : d->left;
+        x1 = x1 < d->left + d->vi.width ? x1 : d->left + d->vi.width;
+        y0 = y0 > d->top ? y0 : d->top;
+        y1 = y1 < d->top + d->vi.height ? y1 : d->top + d->vi.height;
+    }
+    if (x1 <= x0 || y1 <= y0)
+        return;
+
+    float black, white, neutral;
+    colorbars_levels(d, &black, &white, &neutral);
+    const int bps = f->bytesPerSample;
+    uint8_t *glyphs = (uint8_t *)malloc(box_w * bps);
+    uint8_t *blank = (uint8_t *)malloc(box_w * bps);
+    for (int i = 0; i < box_w; i++)
+        put_sample(blank, i, f->colorFamily == cfYUV ? neutral : black, f);
+
+    for (int p = 0; p < f->numPlanes; p++)
+    {
+        const int chroma = p && f->colorFamily == cfYUV;
+        const int ssw = chroma ? f->subSamplingW : 0;
+        const int ssh = chroma ? f->subSamplingH : 0;
+        const ptrdiff_t stride = vsapi->getStride(frame, p);
+        uint8_t *dst = vsapi->getWritePtr(frame, p) + ((x0 - (tsi ? 0 : d->left)) >> ssw) * bps;
+        const int top = tsi ? 0 : d->top >> ssh;
+        const int skip = (x0 - box_x) >> ssw;
+        const int rowsize = ((x1 - x0) >> ssw) * bps;
+        int built = -2;
+        for (int y = y0 >> ssh; y < y1 >> ssh; y++)
+        {
+            if (chroma)
+            {
+                memcpy(dst + (y - top) * stride, blank, rowsize);
+                continue;
+            }
+            const int r = fields ? y * 2 + field : tsi ? colorbars_raster_y(d, y) : y;
+            const int gy = (r - box_y) / scale - 1;
+            if (gy != built)
+            {
+                build_row(glyphs, text, chars, gy, scale, black, white, f);
+                for (int i = (chars * CELL_W + 1) * scale; i < box_w; i++)
+                    put_sample(glyphs, i, black, f);
+                built = gy;
+            }
+            if (tsi)
+            {
+                for (int x = x0; x < x1; x++)
+                    memcpy(dst + y * stride + (x - x0) * bps, glyphs + (colorbars_raster_x(d, x) - box_x) * bps, bps);
+            }
+            else
+                memcpy(dst + (y - top) * stride, glyphs + skip * bps, rowsize);
+        }
+    }
+    free(glyphs);
+    free(blank);
+}
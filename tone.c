@@ -0,0 +1,222 @@
+/*****************************************************************************
+ * colorbars: a vapoursynth plugin for generating color bar test patterns
+ *****************************************************************************
+ * VapourSynth plugin
+ *     Copyright (C) 2022 Phillip Blucas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *****************************************************************************/
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <VapourSynth4.h>
+#include <VSHelper4.h>
+
+#include "colorbars.h"
+
+#define RETERROR(x) do { vsapi->mapSetError(out, (x)); return; } while (0)
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef enum {
+    IDENT_NONE = 0,
+    IDENT_EBU,  // EBU Tech 3304: left interrupted for 250 ms every 3 seconds
+    IDENT_GLITS // left interrupted once, right twice, every 4 seconds
+} ident_e;
+
+// A silent stretch of one channel, in milliseconds into the ident cycle
+typedef struct {
+    int channel;
+    int start;
+    int end;
+} ToneBreak;
+
+static const ToneBreak ebu_breaks[1] = { { 0, 0, 250 } };
+static const ToneBreak glits_breaks[3] = { { 0, 0, 250 }, { 1, 500, 750 }, { 1, 1000, 1250 } };
+
+typedef struct {
+    VSAudioInfo ai;
+    int period;      // samples in a whole number of cycles
+    uint8_t *table;  // period + VS_AUDIO_FRAME_SAMPLES samples, so any frame is a single copy
+    int64_t cycle;   // ident cycle in samples
+    const ToneBreak *breaks;
+    int num_breaks;
+} ToneData;
+
+static const VSFrame *VS_CC toneGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi)
+{
+    ToneData *d = (ToneData *)instanceData;
+    if (activationReason == arInitial)
+    {
+        const int bps = d->ai.format.bytesPerSample;
+        const int64_t start = (int64_t)n * VS_AUDIO_FRAME_SAMPLES;
+        const int len = (int)VSMIN(d->ai.numSamples - start, VS_AUDIO_FRAME_SAMPLES);
+        const uint8_t *src = d->table + (start % d->period) * bps;
+        VSFrame *frame = vsapi->newAudioFrame(&d->ai.format, len, NULL, core);
+        for (int c = 0; c < d->ai.format.numChannels; c++)
+            memcpy(vsapi->getWritePtr(frame, c), src, len * bps);
+
+        // cut the ident breaks that fall inside this frame, zero is silence for every sample type
+        for (int i = 0; i < d->num_breaks; i++)
+        {
+            const ToneBreak *b = &d->breaks[i];
+            const int64_t bstart = (int64_t)b->start * d->ai.sampleRate / 1000;
+            const int64_t bend = (int64_t)b->end * d->ai.sampleRate / 1000;
+            uint8_t *dst = vsapi->getWritePtr(frame, b->channel);
+            for (int64_t c = start / d->cycle * d->cycle; c < start + len; c += d->cycle)
+            {
+                const int64_t s = VSMAX(c + bstart, start);
+                const int64_t e = VSMIN(c + bend, start + len);
+                if (s < e)
+                    memset(dst + (s - start) * bps, 0, (e - s) * bps);
+            }
+        }
+        return frame;
+    }
+    return 0;
+}
+
+static void VS_CC toneFree(void *instanceData, VSCore *core, const VSAPI *vsapi)
+{
+    ToneData *d = (ToneData *)instanceData;
+    free(d->table);
+    free(d);
+}
+
+static int gcd(int a, int b)
+{
+    while (b)
+    {
+        const int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+void VS_CC toneCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
+{
+    ColorBarsData bars = { 0 };
+    ToneData d = { 0 };
+    int err = 0;
+
+    // the video arguments only set the duration, so the tone matches the bars it goes with.
+    // The video format doesn't matter here and may be left out.
+    VSMap *args = vsapi->createMap();
+    vsapi->copyMap(in, args);
+    if (vsapi->mapNumElements(in, "format") < 1)
+        vsapi->mapSetInt(args, "format", vsapi->mapGetInt(in, "hdr", 0, &err) > 0 ? pfRGB36 : pfYUV444P12, maReplace);
+    const char *error = colorbars_parse(&bars, args, core, vsapi);
+    vsapi->freeMap(args);
+    colorbars_free_layout(&bars);
+    if (error)
+        RETERROR(error);
+
+    d.ai.sampleRate = vsapi->mapGetIntSaturated(in, "samplerate", 0, &err);
+    if (err)
+        d.ai.sampleRate = 48000;
+    if (d.ai.sampleRate < 8000 || d.ai.sampleRate > 384000)
+        RETERROR("Tone: invalid sample rate");
+    int frequency = vsapi->mapGetIntSaturated(in, "frequency", 0, &err);
+    if (err)
+        frequency = 1000;
+    if (frequency < 1 || frequency * 2 >= d.ai.sampleRate)
+        RETERROR("Tone: frequency must be below half the sample rate");
+    double level = vsapi->mapGetFloat(in, "level", 0, &err);
+    if (err)
+        level = -18.0;
+    if (!(level <= 0.0))
+        RETERROR("Tone: level must be at or below 0 dBFS");
+    int ident = vsapi->mapGetIntSaturated(in, "ident", 0, &err);
+    if (err)
+        ident = IDENT_NONE;
+    if (ident < IDENT_NONE || ident > IDENT_GLITS)
+        RETERROR("Tone: invalid ident");
+    int channels = vsapi->mapGetIntSaturated(in, "channels", 0, &err);
+    if (err)
+        channels = 2;
+    if (channels < 1 || channels > 8)
+        RETERROR("Tone: only 1 to 8 channels");
+    if (ident == IDENT_GLITS && channels < 2)
+        RETERROR("Tone: GLITS needs at least two channels");
+    int sampletype = vsapi->mapGetIntSaturated(in, "sampletype", 0, &err);
+    if (err)
+        sampletype = stInteger;
+    int bits = vsapi->mapGetIntSaturated(in, "bits", 0, &err);
+    if (err)
+        bits = sampletype == stFloat ? 32 : 16;
+    if (sampletype == stFloat ? bits != 32 : sampletype != stInteger || (bits != 16 && bits != 32))
+        RETERROR("Tone: only 16 or 32-bit integer and 32-bit float samples");
+    vsapi->queryAudioFormat(&d.ai.format, sampletype, bits, (1ULL << channels) - 1, core);
+
+    // same duration as the clip, rounded to the nearest sample.  Exact while the product fits in
+    // 64 bits, fpsden is unbounded so past that it is worked out as a double and range checked.
+    // Audio frames are counted in an int like video frames, which bounds the length.
+    const int64_t max_samples = (int64_t)INT_MAX * VS_AUDIO_FRAME_SAMPLES;
+    const int64_t frame_samples = (int64_t)bars.vi.numFrames * d.ai.sampleRate;
+    if (bars.vi.fpsDen <= (INT64_MAX - bars.vi.fpsNum / 2) / frame_samples)
+        d.ai.numSamples = (frame_samples * bars.vi.fpsDen + bars.vi.fpsNum / 2) / bars.vi.fpsNum;
+    else
+    {
+        const double samples = (double)frame_samples * ((double)bars.vi.fpsDen / bars.vi.fpsNum) + 0.5;
+        d.ai.numSamples = samples < (double)max_samples ? (int64_t)samples : max_samples + 1;
+    }
+    if (d.ai.numSamples > max_samples)
+        RETERROR("Tone: the clip is too long for the sample rate");
+    if (d.ai.numSamples < 1)
+        d.ai.numSamples = 1;
+
+    if (ident == IDENT_EBU)
+    {
+        d.breaks = ebu_breaks;
+        d.num_breaks = 1;
+        d.cycle = 3 * (int64_t)d.ai.sampleRate;
+    }
+    else if (ident == IDENT_GLITS)
+    {
+        d.breaks = glits_breaks;
+        d.num_breaks = 3;
+        d.cycle = 4 * (int64_t)d.ai.sampleRate;
+    }
+
+    // the shortest run of samples holding a whole number of cycles, e.g. 48 at 1 kHz and 48 kHz
+    const int g = gcd(d.ai.sampleRate, frequency);
+    const int cycles = frequency / g;
+    const int bps = d.ai.format.bytesPerSample;
+    d.period = d.ai.sampleRate / g;
+    d.table = (uint8_t *)malloc((size_t)(d.period + VS_AUDIO_FRAME_SAMPLES) * bps);
+    const double peak = pow(10.0, level / 20.0);
+    const double scale = sampletype == stFloat ? 1.0 : bits == 16 ? 32767.0 : 2147483647.0;
+    for (int i = 0; i < d.period + VS_AUDIO_FRAME_SAMPLES; i++)
+    {
+        const int64_t phase = (int64_t)(i % d.period) * cycles % d.period;
+        const double v = peak * sin(2.0 * M_PI * phase / d.period);
+        if (sampletype == stFloat)
+            ((float *)d.table)[i] = (float)v;
+        else if (bits == 16)
+            ((int16_t *)d.table)[i] = (int16_t)lrint(v * scale);
+        else
+            ((int32_t *)d.table)[i] = (int32_t)llrint(v * scale);
+    }
+
+    ToneData *data = (ToneData *)malloc(sizeof(d));
+    *data = d;
+    vsapi->createAudioFilter(out, "Tone", &d.ai, toneGetFrame, toneFree, fmParallel, NULL, 0, data, core);
+}
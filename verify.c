@@ -0,0 +1,299 @@
+/*****************************************************************************
+ * colorbars: a vapoursynth plugin for generating color bar test patterns
+ *****************************************************************************
+ * VapourSynth plugin
+ *     Copyright (C) 2022 Phillip Blucas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *****************************************************************************/
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <VapourSynth4.h>
+
+#include "colorbars.h"
+
+#define RETERROR(x) do { vsapi->mapSetError(out, (x)); return; } while (0)
+
+// PSNR of a bar that matches exactly
+#define VERIFY_PSNR_MAX 999.0
+
+// The interior of one bar, away from its shaped edges, in samples and rows of the clip's plane
+typedef struct {
+    int plane;
+    int x;
+    int y;
+    int width;
+    int height;
+    const uint8_t *ref; // the samples every row of it should have
+} VerifyBar;
+
+typedef struct {
+    VSNode *node;
+    VSVideoInfo vi;
+    const ColorBarsKernels *kernels;
+    int fields; // separate fields, frame n is field (n & 1) ^ bff
+    int bff;
+    VerifyBar *bars[2];
+    int num_bars[2];
+    int64_t *rects[2]; // x, y, width and height of each bar, for the frame properties
+    int64_t *planes[2]; // and its plane
+    double *expected[2]; // mean of each bar's expected samples
+    uint8_t *rows[2]; // the first row of every band of every plane, drawn once
+    int rows_per_bar; // rows measured in each bar, 0 for all of them
+    double tolerance;
+    double peak; // largest sample value, for PSNR
+} VerifyData;
+
+static void measure(const VerifyData *d, const VerifyBar *bar, const uint8_t *src, ptrdiff_t stride, ColorBarsStat *st)
+{
+    const VSVideoFormat *f = &d->vi.format;
+    const int rows = d->rows_per_bar && d->rows_per_bar < bar->height ? d->rows_per_bar : bar->height;
+    src += (ptrdiff_t)bar->y * stride + (ptrdiff_t)bar->x * f->bytesPerSample;
+    for (int i = 0; i < rows; i++)
+    {
+        // spread over the bar, centered in equal parts of it
+        const int r = rows == bar->height ? i : (int)((2 * (int64_t)i + 1) * bar->height / (2 * rows));
+        const uint8_t *row = src + r * stride;
+        if (f->sampleType == stFloat)
+            d->kernels->stat_f32((const float *)row, (const float *)bar->ref, bar->width, st);
+        else if (f->bytesPerSample == 1)
+            d->kernels->stat_u8(row, bar->ref, bar->width, st);
+        else
+            d->kernels->stat((const uint16_t *)row, (const uint16_t *)bar->ref, bar->width, st);
+    }
+}
+
+static const VSFrame *VS_CC verifyGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi)
+{
+    VerifyData *d = (VerifyData *)instanceData;
+    if (activationReason == arInitial)
+        vsapi->requestFrameFilter(n, d->node, frameCtx);
+    else if (activationReason == arAllFramesReady)
+    {
+        const VSFrame *src = vsapi->getFrameFilter(n, d->node, frameCtx);
+        VSFrame *frame = vsapi->copyFrame(src, core);
+        vsapi->freeFrame(src);
+        VSMap *props = vsapi->getFramePropertiesRW(frame);
+
+        const int field = d->fields ? (n & 1) ^ d->bff : 0;
+        const int num_bars = d->num_bars[field];
+        double *results = (double *)malloc(sizeof(double) * 3 * num_bars);
+        double *mean = results;
+        double *deviation = results + num_bars;
+        double *psnr = results + 2 * num_bars;
+        double max_deviation = 0.0;
+        double min_psnr = VERIFY_PSNR_MAX;
+        for (int i = 0; i < num_bars; i++)
+        {
+            const VerifyBar *bar = &d->bars[field][i];
+            ColorBarsStat st = { 0 };
+            measure(d, bar, vsapi->getReadPtr(frame, bar->plane), vsapi->getStride(frame, bar->plane), &st);
+            const double mse = st.sq / st.n;
+            mean[i] = st.sum / st.n;
+            deviation[i] = st.max;
+            psnr[i] = mse > 0.0 ? 10.0 * log10(d->peak * d->peak / mse) : VERIFY_PSNR_MAX;
+            max_deviation = st.max > max_deviation ? st.max : max_deviation;
+            min_psnr = psnr[i] < min_psnr ? psnr[i] : min_psnr;
+        }
+        vsapi->mapSetIntArray(props, "ColorBarsVerifyPlane", d->planes[field], num_bars);
+        vsapi->mapSetIntArray(props, "ColorBarsVerifyRect", d->rects[field], 4 * num_bars);
+        vsapi->mapSetFloatArray(props, "ColorBarsVerifyExpected", d->expected[field], num_bars);
+        vsapi->mapSetFloatArray(props, "ColorBarsVerifyMean", mean, num_bars);
+        vsapi->mapSetFloatArray(props, "ColorBarsVerifyDeviation", deviation, num_bars);
+        vsapi->mapSetFloatArray(props, "ColorBarsVerifyPSNR", psnr, num_bars);
+        vsapi->mapSetFloat(props, "ColorBarsVerifyMaxDeviation", max_deviation, maReplace);
+        vsapi->mapSetFloat(props, "ColorBarsVerifyMinPSNR", min_psnr, maReplace);
+        vsapi->mapSetInt(props, "ColorBarsVerifyPass", max_deviation <= d->tolerance, maReplace);
+        free(results);
+        return frame;
+    }
+    return 0;
+}
+
+static void free_verify(VerifyData *d, const VSAPI *vsapi)
+{
+    vsapi->freeNode(d->node);
+    for (int f = 0; f < 2; f++)
+    {
+        free(d->bars[f]);
+        free(d->rects[f]);
+        free(d->planes[f]);
+        free(d->expected[f]);
+        free(d->rows[f]);
+    }
+}
+
+static void VS_CC verifyFree(void *instanceData, VSCore *core, const VSAPI *vsapi)
+{
+    VerifyData *d = (VerifyData *)instanceData;
+    free_verify(d, vsapi);
+    free(d);
+}
+
+// Lists the bar interiors of one field (or the frame) that the clip shows, at least margin samples
+// and rows from every edge, and draws what they should hold
+static void find_bars(VerifyData *d, const ColorBarsData *bars, int field, int margin)
+{
+    const VSVideoFormat *f = &bars->vi.format;
+    const int bps = f->bytesPerSample;
+    int num_spans = 0;
+    size_t rowbytes = 0;
+    for (int p = 0; p < f->numPlanes; p++)
+    {
+        const ColorBarsPlane *plane = &bars->planes[field][p];
+        num_spans += plane->num_spans;
+        rowbytes += (size_t)plane->num_bands * (bars->raster_width >> (p ? f->subSamplingW : 0)) * bps;
+    }
+    d->bars[field] = (VerifyBar *)malloc(sizeof(VerifyBar) * (num_spans ? num_spans : 1));
+    d->rows[field] = (uint8_t *)calloc(1, rowbytes ? rowbytes : 1);
+
+    uint8_t *row = d->rows[field];
+    int n = 0;
+    for (int p = 0; p < f->numPlanes; p++)
+    {
+        const ColorBarsPlane *plane = &bars->planes[field][p];
+        const int ssw = p ? f->subSamplingW : 0;
+        const int ssh = p ? f->subSamplingH : 0;
+        const int left = bars->left >> ssw;
+        const int top = bars->top >> ssh;
+        const int right = left + (bars->vi.width >> ssw);
+        const int bottom = top + (bars->vi.height >> ssh);
+        // the margin is in luma samples, rounded up for chroma
+        const int mx = (margin + (1 << ssw) - 1) >> ssw;
+        const int my = (margin + (1 << ssh) - 1) >> ssh;
+        for (int b = 0; b < plane->num_bands; b++)
+        {
+            const ColorBarsBand *band = &plane->bands[b];
+            colorbars_draw_band(bars, plane, b, row);
+            const int y0 = band->y + my > top ? band->y + my : top;
+            const int y1 = band->y + band->height - my < bottom ? band->y + band->height - my : bottom;
+            for (int s = band->span; s < band->span + band->num_spans && y0 < y1; s++)
+            {
+                const ColorBarsSpan *span = &plane->spans[s];
+                const int x0 = span->x + mx > left ? span->x + mx : left;
+                const int x1 = span->x + span->width - mx < right ? span->x + span->width - mx : right;
+                if (x1 <= x0)
+                    continue;
+                VerifyBar *bar = &d->bars[field][n++];
+                bar->plane = p;
+                bar->x = x0 - left;
+                bar->y = y0 - top;
+                bar->width = x1 - x0;
+                bar->height = y1 - y0;
+                bar->ref = row + (size_t)x0 * bps;
+            }
+            row += (size_t)(bars->raster_width >> ssw) * bps;
+        }
+    }
+    d->num_bars[field] = n;
+
+    d->rects[field] = (int64_t *)malloc(sizeof(int64_t) * 4 * (n ? n : 1));
+    d->planes[field] = (int64_t *)malloc(sizeof(int64_t) * (n ? n : 1));
+    d->expected[field] = (double *)malloc(sizeof(double) * (n ? n : 1));
+    for (int i = 0; i < n; i++)
+    {
+        const VerifyBar *bar = &d->bars[field][i];
+        int64_t *rect = d->rects[field] + 4 * i;
+        rect[0] = bar->x;
+        rect[1] = bar->y;
+        rect[2] = bar->width;
+        rect[3] = bar->height;
+        d->planes[field][i] = bar->plane;
+        // measured against itself, the sum is the expected mean
+        ColorBarsStat st = { 0 };
+        if (f->sampleType == stFloat)
+            d->kernels->stat_f32((const float *)bar->ref, (const float *)bar->ref, bar->width, &st);
+        else if (bps == 1)
+            d->kernels->stat_u8(bar->ref, bar->ref, bar->width, &st);
+        else
+            d->kernels->stat((const uint16_t *)bar->ref, (const uint16_t *)bar->ref, bar->width, &st);
+        d->expected[field][i] = st.sum / st.n;
+    }
+}
+
+void VS_CC verifyCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
+{
+    VerifyData d = { 0 };
+    ColorBarsData bars = { 0 };
+    int err = 0;
+
+    d.node = vsapi->mapGetNode(in, "clip", 0, 0);
+    d.vi = *vsapi->getVideoInfo(d.node);
+    const VSVideoFormat *f = &d.vi.format;
+    if (f->colorFamily == cfUndefined || !d.vi.width || !d.vi.height)
+    {
+        vsapi->freeNode(d.node);
+        RETERROR("Verify: the clip must have a constant format and size");
+    }
+
+    // the bars are described with the ColorBars arguments, in the clip's format unless given
+    VSMap *args = vsapi->createMap();
+    vsapi->copyMap(in, args);
+    if (vsapi->mapNumElements(in, "format") < 1)
+        vsapi->mapSetInt(args, "format", vsapi->queryVideoFormatID(f->colorFamily, f->sampleType, f->bitsPerSample,
+                                                                   f->subSamplingW, f->subSamplingH, core), maReplace);
+    const char *error = colorbars_parse(&bars, args, core, vsapi);
+    vsapi->freeMap(args);
+    if (!error && bars.pattern != PATTERN_BARS)
+        error = "Verify: only the bars can be verified";
+    else if (!error && bars.timecode)
+        error = "Verify: the bars can't have a timecode";
+    else if (!error && (bars.vi.width != d.vi.width || bars.vi.height != d.vi.height ||
+                        bars.vi.format.colorFamily != f->colorFamily || bars.vi.format.sampleType != f->sampleType ||
+                        bars.vi.format.bitsPerSample != f->bitsPerSample ||
+                        bars.vi.format.subSamplingW != f->subSamplingW || bars.vi.format.subSamplingH != f->subSamplingH))
+        error = "Verify: the clip doesn't have the size and format of the bars";
+
+    // filter shaping reaches 4 samples from an edge, chains downstream usually reach further
+    int margin = vsapi->mapGetIntSaturated(in, "margin", 0, &err);
+    if (err)
+        margin = 8;
+    if (!error && margin < 0)
+        error = "Verify: margin can't be negative";
+    d.rows_per_bar = vsapi->mapGetIntSaturated(in, "rows", 0, &err);
+    if (!error && d.rows_per_bar < 0)
+        error = "Verify: rows can't be negative";
+    d.tolerance = vsapi->mapGetFloat(in, "tolerance", 0, &err);
+    if (!error && !(d.tolerance >= 0.0))
+        error = "Verify: tolerance can't be negative";
+
+    if (!error)
+    {
+        d.kernels = bars.kernels;
+        d.fields = bars.scan == SCAN_FIELDS;
+        d.bff = bars.bff;
+        d.peak = f->sampleType == stFloat ? 1.0 : (1 << f->bitsPerSample) - 1;
+        for (int field = 0; field <= d.fields; field++)
+        {
+            find_bars(&d, &bars, field, margin);
+            if (!d.num_bars[field])
+                error = "Verify: no bar is left to measure, try a smaller margin";
+        }
+    }
+    colorbars_free_layout(&bars);
+    if (error)
+    {
+        free_verify(&d, vsapi);
+        RETERROR(error);
+    }
+
+    VerifyData *data = (VerifyData *)malloc(sizeof(d));
+    *data = d;
+    VSFilterDependency deps[] = { { d.node, rpStrictSpatial } };
+    vsapi->createVideoFilter(out, "Verify", &d.vi, verifyGetFrame, verifyFree, fmParallel, deps, 1, data, core);
+}
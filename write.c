@@ -0,0 +1,324 @@
+/*****************************************************************************
+ * colorbars: a vapoursynth plugin for generating color bar test patterns
+ *****************************************************************************
+ * VapourSynth plugin
+ *     Copyright (C) 2022 Phillip Blucas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *****************************************************************************/
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700
+#endif
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include <VapourSynth4.h>
+#include <VSConstants4.h>
+
+#include "colorbars.h"
+
+#define RETERROR(x) do { vsapi->mapSetError(out, (x)); return; } while (0)
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#ifdef _WIN32
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+#endif
+
+// iovecs handed to a single writev call
+#define WRITE_IOV 1024
+
+typedef enum {
+    CONTAINER_RAW = 0,
+    CONTAINER_Y4M,
+    CONTAINER_V210
+} container_e;
+
+static int write_all(int fd, const uint8_t *buf, size_t len)
+{
+    while (len)
+    {
+#ifdef _WIN32
+        int w = _write(fd, buf, len > (1U << 30) ? (1U << 30) : (unsigned)len);
+#else
+        ssize_t w = write(fd, buf, len);
+#endif
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return -1;
+        buf += w;
+        len -= w;
+    }
+    return 0;
+}
+
+// Writes the segments of one frame count times over.  The same few buffers are repeated
+// in each writev, so nothing is copied no matter how many frames go out.
+static int write_frames(int fd, const struct iovec *segs, int num_segs, int count)
+{
+    const int64_t total = (int64_t)count * num_segs;
+#ifdef _WIN32
+    for (int64_t i = 0; i < total; i++)
+        if (write_all(fd, segs[i % num_segs].iov_base, segs[i % num_segs].iov_len))
+            return -1;
+#else
+    struct iovec iov[WRITE_IOV];
+    int64_t next = 0;
+    while (next < total)
+    {
+        int n = 0;
+        for (; n < WRITE_IOV && next + n < total; n++)
+            iov[n] = segs[(next + n) % num_segs];
+        ssize_t w = writev(fd, iov, n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w < 0)
+            return -1;
+
+        // skip what went out and finish a partially written segment by hand
+        int i = 0;
+        while (i < n && (size_t)w >= iov[i].iov_len)
+            w -= iov[i++].iov_len;
+        if (i < n)
+        {
+            if (write_all(fd, (const uint8_t *)iov[i].iov_base + w, iov[i].iov_len - w))
+                return -1;
+            i++;
+        }
+        next += i;
+    }
+#endif
+    return 0;
+}
+
+static void put_le32(uint8_t *dst, uint32_t v)
+{
+    dst[0] = v;
+    dst[1] = v >> 8;
+    dst[2] = v >> 16;
+    dst[3] = v >> 24;
+}
+
+// 10-bit 4:2:2 packed as Cb Y Cr Y in 32-bit little endian words, three samples per word.
+// Each line is padded to a multiple of 48 pixels (128 bytes).
+static uint8_t *pack_v210(const VSFrame *frame, const VSAPI *vsapi, size_t *size)
+{
+    const int width = vsapi->getFrameWidth(frame, 0);
+    const int height = vsapi->getFrameHeight(frame, 0);
+    const size_t stride = (size_t)(width + 47) / 48 * 128;
+    uint8_t *buf = (uint8_t *)calloc(stride, height);
+    if (!buf)
+        return NULL;
+
+    for (int y = 0; y < height; y++)
+    {
+        const uint16_t *srcy = (const uint16_t *)(vsapi->getReadPtr(frame, 0) + y * vsapi->getStride(frame, 0));
+        const uint16_t *srcu = (const uint16_t *)(vsapi->getReadPtr(frame, 1) + y * vsapi->getStride(frame, 1));
+        const uint16_t *srcv = (const uint16_t *)(vsapi->getReadPtr(frame, 2) + y * vsapi->getStride(frame, 2));
+        uint8_t *dst = buf + y * stride;
+        for (int x = 0; x < width; x += 6, dst += 16)
+        {
+            // the last group of a line is zero padded
+            uint32_t yy[6] = { 0 }, u[3] = { 0 }, v[3] = { 0 };
+            for (int i = 0; i < 6 && x + i < width; i++)
+                yy[i] = srcy[x + i];
+            for (int i = 0; i < 3 && x + 2 * i < width; i++)
+            {
+                u[i] = srcu[x / 2 + i];
+                v[i] = srcv[x / 2 + i];
+            }
+            put_le32(dst,      u[0]  | (yy[0] << 10) | (v[0]  << 20));
+            put_le32(dst + 4,  yy[1] | (u[1]  << 10) | (yy[2] << 20));
+            put_le32(dst + 8,  v[1]  | (yy[3] << 10) | (u[2]  << 20));
+            put_le32(dst + 12, yy[4] | (v[2]  << 10) | (yy[5] << 20));
+        }
+    }
+    *size = stride * height;
+    return buf;
+}
+
+static int y4m_header(char *header, size_t size, const VSFrame *frame, const VSVideoInfo *vi, const VSAPI *vsapi)
+{
+    const VSMap *props = vsapi->getFramePropertiesRO(frame);
+    int err = 0;
+    const char *chroma = vi->format.subSamplingH ? "420" : vi->format.subSamplingW ? "422" : "444";
+    char colorspace[16];
+    // 8-bit has no depth suffix, and plain 420 would mean centered chroma
+    if (vi->format.bitsPerSample == 8)
+        snprintf(colorspace, sizeof(colorspace), "%s%s", chroma, vi->format.subSamplingH ? "mpeg2" : "");
+    else
+        snprintf(colorspace, sizeof(colorspace), "%sp%d", chroma, vi->format.bitsPerSample);
+    const int64_t fieldbased = vsapi->mapGetInt(props, "_FieldBased", 0, &err);
+    const char interlace = fieldbased == VSC_FIELD_TOP ? 't' : fieldbased == VSC_FIELD_BOTTOM ? 'b' : 'p';
+    return snprintf(header, size, "YUV4MPEG2 W%d H%d F%lld:%lld I%c A%lld:%lld C%s XCOLORRANGE=%s\n",
+                    vi->width, vi->height, (long long)vi->fpsNum, (long long)vi->fpsDen, interlace,
+                    (long long)vsapi->mapGetInt(props, "_SARNum", 0, NULL), (long long)vsapi->mapGetInt(props, "_SARDen", 0, NULL),
+                    colorspace, vsapi->mapGetInt(props, "_ColorRange", 0, NULL) ? "LIMITED" : "FULL");
+}
+
+// Appends the iovecs of one output frame.  Anything that has to be repacked goes into packed.
+static int frame_segments(const VSFrame *frame, const VSVideoFormat *f, container_e container, uint8_t *packed[3],
+                          struct iovec *segs, int *num_segs, const VSAPI *vsapi)
+{
+    if (container == CONTAINER_Y4M)
+    {
+        static const char tag[] = "FRAME\n";
+        segs[*num_segs].iov_base = (void *)tag;
+        segs[(*num_segs)++].iov_len = sizeof(tag) - 1;
+    }
+    if (container == CONTAINER_V210)
+    {
+        size_t size = 0;
+        packed[0] = pack_v210(frame, vsapi, &size);
+        segs[*num_segs].iov_base = packed[0];
+        segs[(*num_segs)++].iov_len = size;
+        return !packed[0];
+    }
+
+    // planes without row padding go out straight from the frame
+    for (int p = 0; p < f->numPlanes; p++)
+    {
+        const uint8_t *src = vsapi->getReadPtr(frame, p);
+        const ptrdiff_t stride = vsapi->getStride(frame, p);
+        const size_t rowsize = (size_t)vsapi->getFrameWidth(frame, p) * f->bytesPerSample;
+        const int height = vsapi->getFrameHeight(frame, p);
+        if ((size_t)stride != rowsize)
+        {
+            packed[p] = (uint8_t *)malloc(rowsize * height);
+            if (!packed[p])
+                return 1;
+            for (int y = 0; y < height; y++)
+                memcpy(packed[p] + y * rowsize, src + y * stride, rowsize);
+            src = packed[p];
+        }
+        segs[*num_segs].iov_base = (void *)src;
+        segs[(*num_segs)++].iov_len = rowsize * height;
+    }
+    return 0;
+}
+
+void VS_CC writeCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
+{
+    ColorBarsData d = { 0 };
+    int err = 0;
+
+    const char *error = colorbars_parse(&d, in, core, vsapi);
+    if (error)
+    {
+        colorbars_free_layout(&d);
+        RETERROR(error);
+    }
+
+    container_e container = CONTAINER_RAW;
+    const char *name = vsapi->mapGetData(in, "container", 0, &err);
+    if (!err)
+    {
+        if (!strcmp(name, "y4m"))
+            container = CONTAINER_Y4M;
+        else if (!strcmp(name, "v210"))
+            container = CONTAINER_V210;
+        else if (strcmp(name, "raw"))
+            error = "Write: invalid container, only raw, y4m and v210";
+    }
+    if (d.pattern != PATTERN_BARS)
+        error = "Write: only the bar pattern can be written, the zone plate changes every frame";
+    if (d.timecode)
+        error = "Write: a timecode changes every frame and cannot be written";
+    if (container == CONTAINER_Y4M && (d.vi.format.colorFamily != cfYUV || d.vi.format.sampleType != stInteger))
+        error = "Write: y4m needs an integer YUV format";
+    if (container == CONTAINER_V210 && (d.vi.format.colorFamily != cfYUV || d.vi.format.bitsPerSample != 10 ||
+                                        d.vi.format.subSamplingW != 1 || d.vi.format.subSamplingH != 0))
+        error = "Write: v210 needs YUV422P10";
+    if (error)
+    {
+        colorbars_free_layout(&d);
+        RETERROR(error);
+    }
+
+    // one frame (or one of each field) is rendered and packed, then the cycle is written over and over
+    const int images = d.scan == SCAN_FIELDS ? 2 : 1;
+    VSFrame *frames[2] = { NULL };
+    uint8_t *packed[2][3] = { { NULL } };
+    struct iovec segs[8];
+    char header[256];
+    int num_segs = 0;
+
+    for (int i = 0; i < images; i++)
+    {
+        frames[i] = colorbars_render(&d, i ^ d.bff, core, vsapi);
+        if (frame_segments(frames[i], &d.vi.format, container, packed[i], segs, &num_segs, vsapi))
+            error = "Write: out of memory";
+    }
+    colorbars_free_layout(&d);
+
+    const char *file = vsapi->mapGetData(in, "file", 0, NULL);
+    int fd = 1;
+    if (!error)
+    {
+        if (strcmp(file, "-"))
+            fd = open(file, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+#ifdef _WIN32
+        else
+            _setmode(fd, O_BINARY);
+#endif
+        if (fd < 0)
+            error = "Write: unable to open the output file";
+    }
+
+    int64_t bytes = 0;
+    if (!error && container == CONTAINER_Y4M)
+    {
+        int len = y4m_header(header, sizeof(header), frames[0], &d.vi, vsapi);
+        if (write_all(fd, (const uint8_t *)header, len))
+            error = "Write: write failed";
+        bytes += len;
+    }
+    if (!error)
+    {
+        if (write_frames(fd, segs, num_segs, d.vi.numFrames / images))
+            error = "Write: write failed";
+        for (int i = 0; i < num_segs; i++)
+            bytes += (int64_t)segs[i].iov_len * (d.vi.numFrames / images);
+    }
+    if (fd >= 0 && fd != 1)
+        close(fd);
+
+    for (int i = 0; i < images; i++)
+    {
+        for (int p = 0; p < 3; p++)
+            free(packed[i][p]);
+        vsapi->freeFrame(frames[i]);
+    }
+
+    if (error)
+        RETERROR(error);
+    vsapi->mapSetInt(out, "bytes", bytes, maReplace);
+}
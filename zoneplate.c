@@ -0,0 +1,151 @@
+/*****************************************************************************
+ * colorbars: a vapoursynth plugin for generating color bar test patterns
+ *****************************************************************************
+ * VapourSynth plugin
+ *     Copyright (C) 2022 Phillip Blucas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include <VapourSynth4.h>
+
+#include "colorbars.h"
+
+// The circular zone plate is sin(2 pi (r^2 / 2w + t * speed)), with r measured from the center of
+// the frame.  Its frequency grows linearly from DC in the center to Nyquist at the left and right
+// edges.  The phase splits into a column term, tabulated once, and a row term that changes per
+// line and per frame, so each line is one pass of the sine kernel.  Both terms are kept as
+// fractions of a turn so the single precision sum never loses the low bits of a large radius.
+
+static double frac(double v)
+{
+    return v - (double)(int64_t)v;
+}
+
+static double zone_scale(const ColorBarsData *d)
+{
+    return 1.0 / (2.0 * d->raster_width);
+}
+
+void colorbars_zoneplate_init(ColorBarsData *d)
+{
+    const int width = d->vi.width;
+    const double k = zone_scale(d);
+    const double cx = d->raster_width / 2.0;
+    d->zone = (float *)malloc(width * sizeof(float));
+    for (int x = 0; x < width; x++)
+    {
+        const int rx = colorbars_raster_x(d, x);
+        d->zone[x] = (float)frac((rx - cx) * (rx - cx) * k);
+    }
+}
+
+static void store_row(uint8_t *dst, const float *row, int width, const VSVideoFormat *f)
+{
+    // the kernel output already carries the rounding offset
+    if (f->bytesPerSample == 1)
+    {
+        for (int i = 0; i < width; i++)
+            dst[i] = (uint8_t)(int)row[i];
+    }
+    else
+    {
+        uint16_t *dst16 = (uint16_t *)dst;
+        for (int i = 0; i < width; i++)
+            dst16[i] = (uint16_t)(int)row[i];
+    }
+}
+
+static void fill_row(uint8_t *dst, int width, float value, const ColorBarsKernels *k, const VSVideoFormat *f)
+{
+    if (f->sampleType == stFloat)
+        k->fill_f32((float *)dst, width, value);
+    else if (f->bytesPerSample == 1)
+        k->fill_u8(dst, width, (uint8_t)value);
+    else
+        k->fill((uint16_t *)dst, width, (uint16_t)value);
+}
+
+VSFrame *colorbars_zoneplate_render(const ColorBarsData *d, int n, VSCore *core, const VSAPI *vsapi)
+{
+    const VSVideoFormat *f = &d->vi.format;
+    const int width = d->vi.width;
+    const int height = d->vi.height;
+    const int fields = d->scan == SCAN_FIELDS;
+    const int field = fields ? (n & 1) ^ d->bff : 0;
+    const double k = zone_scale(d);
+    const double cy = (fields ? d->raster_height * 2 : d->raster_height) / 2.0;
+    const int64_t start = colorbars_clock_ns();
+
+    VSFrame *frame = vsapi->newVideoFrame(f, width, height, 0, core);
+    colorbars_set_props(d, field, vsapi->getFramePropertiesRW(frame), vsapi);
+
+    float lo, hi, neutral;
+    colorbars_levels(d, &lo, &hi, &neutral);
+    const float amp = (hi - lo) / 2.0f;
+    const float offset = (hi + lo) / 2.0f + (f->sampleType == stInteger ? 0.5f : 0.0f);
+
+    float *row = f->sampleType == stInteger ? (float *)malloc(width * sizeof(float)) : NULL;
+    uint8_t *dst = vsapi->getWritePtr(frame, 0);
+    const ptrdiff_t stride = vsapi->getStride(frame, 0);
+    for (int y = 0; y < height; y++, dst += stride)
+    {
+        // the frame line and instant this line belongs to, every field is its own instant
+        int r = colorbars_raster_y(d, y);
+        int64_t t = n;
+        if (fields)
+            r = r * 2 + field;
+        else if (d->scan == SCAN_INTERLACED)
+            t = (int64_t)n * 2 + ((r & 1) ^ d->bff);
+        const float shift = (float)frac(frac((r - cy) * (r - cy) * k) + frac(t * (double)d->speed));
+        if (row)
+        {
+            d->kernels->sine(row, d->zone, width, shift, offset, amp);
+            store_row(dst, row, width, f);
+        }
+        else
+            d->kernels->sine((float *)dst, d->zone, width, shift, offset, amp);
+    }
+    free(row);
+
+    // gray for RGB, neutral chroma for YUV
+    const uint8_t *luma = vsapi->getReadPtr(frame, 0);
+    for (int p = 1; p < f->numPlanes; p++)
+    {
+        uint8_t *plane = vsapi->getWritePtr(frame, p);
+        const ptrdiff_t pstride = vsapi->getStride(frame, p);
+        const int pwidth = vsapi->getFrameWidth(frame, p);
+        const int pheight = vsapi->getFrameHeight(frame, p);
+        for (int y = 0; y < pheight; y++)
+        {
+            if (f->colorFamily == cfRGB)
+                memcpy(plane + y * pstride, luma + y * stride, width * f->bytesPerSample);
+            else
+                fill_row(plane + y * pstride, pwidth, neutral, d->kernels, f);
+        }
+    }
+
+    int64_t bytes = 0;
+    for (int p = 0; p < f->numPlanes; p++)
+        bytes += (int64_t)vsapi->getFrameWidth(frame, p) * vsapi->getFrameHeight(frame, p) * f->bytesPerSample;
+    const int64_t ns = colorbars_clock_ns() - start;
+    colorbars_count_render(ns, bytes);
+    if (d->stats)
+        colorbars_set_stats(d, vsapi->getFramePropertiesRW(frame), ns, bytes, vsapi);
+    return frame;
+}